@@ -5,9 +5,20 @@ layout (location = 2) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
+//Per frame values shared by all programs, FrameUniforms of Simulation (std140)
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    vec3 dirLightDir;
+    vec3 dirLightColor;
+    vec3 lightPos;
+    vec3 lightColor;
+    float time;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
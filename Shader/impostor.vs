@@ -0,0 +1,54 @@
+#version 330 core
+layout (location = 3) in vec3 instancePosition;
+layout (location = 4) in uint instanceColor; //Type or RGB8 with bit 31 set
+
+out vec2 TexCoords;
+out vec3 vColor;
+out vec3 Normal;
+out vec3 FragPos;
+out vec3 Position;
+flat out vec3 Center;
+
+//Per frame values shared by all programs, FrameUniforms of Simulation (std140)
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    vec3 dirLightDir;
+    vec3 dirLightColor;
+    vec3 lightPos;
+    vec3 lightColor;
+    float time;
+};
+
+uniform float scale;
+uniform vec3 typeColors[32]; //SimulationCore::MAX_TYPES
+uniform vec3 sphereCenter;   //Bounding sphere of the sphere mesh
+uniform float sphereRadius;
+
+//One quad per particle (triangle strip of 4 vertices), particles.fs ray-casts the sphere
+void main()
+{
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    Center = instancePosition + sphereCenter * scale;
+    float radius = sphereRadius * scale;
+
+    //Through the center facing the camera, just large enough to cover the silhouette in perspective (nothing if the camera is inside)
+    vec3 toCenter = Center - viewPos;
+    float distance = length(toCenter);
+    vec3 forward = toCenter / distance;
+    vec3 right = normalize(cross(forward, abs(forward.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+    vec3 up = cross(right, forward);
+    float size = distance > radius ? radius * distance / sqrt(distance * distance - radius * radius) : 0.0;
+
+    FragPos = Center + (right * corner.x + up * corner.y) * size;
+    Position = FragPos;
+    Normal = -forward;
+    TexCoords = corner * 0.5 + 0.5;
+    if ((instanceColor & 0x80000000u) != 0u)
+        vColor = vec3((instanceColor >> 16) & 0xFFu, (instanceColor >> 8) & 0xFFu, instanceColor & 0xFFu) / 255.0;
+    else
+        vColor = typeColors[min(instanceColor, 31u)];
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
\ No newline at end of file
@@ -6,27 +6,44 @@ in vec3 vColor;
 in vec3 Normal;
 in vec3 FragPos;
 in vec3 Position;
+#ifdef IMPOSTOR
+flat in vec3 Center; //Sphere of the particle
+#endif
 
 uniform sampler2D texture_diffuse1;
 
 uniform vec3 color;
 
-uniform vec3 lightPos;
-
-uniform vec3 lightColor;
-
-uniform vec3 viewPos;
+//Per frame values shared by all programs, FrameUniforms of Simulation (std140)
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    vec3 dirLightDir;
+    vec3 dirLightColor;
+    vec3 lightPos;
+    vec3 lightColor;
+    float time;
+};
 
 uniform int shininess;
 
-uniform vec3 dirLightDir;
-uniform vec3 dirLightColor;
-
 uniform int shaderChoice;
 
+//Impostors (impostorShader, compiled with IMPOSTOR): the quad of the particle is ray-cast against its sphere.
+//Only they write gl_FragDepth, the mesh program keeps early depth testing.
+#ifdef IMPOSTOR
+uniform float sphereRadius;
+uniform float scale;
+#endif
+
 uniform samplerCube skybox; 
 
-uniform float time;
+//Surface of the fragment: interpolated from the mesh or ray-cast for impostors
+vec3 normal;
+vec3 fragPos;
+vec3 position;
 
 
 vec3 calculateColor(float angle){
@@ -67,15 +84,15 @@ vec3 calculateDirLight(){
     vec3 ambient = ambientStrength * vColor;
     
     // Point Light
-    vec3 norm = normalize(Normal); 
-    vec3 lightDir = normalize(lightPos - FragPos);
+    vec3 norm = normal; 
+    vec3 lightDir = normalize(lightPos - fragPos);
     
     float diff = max(dot(norm, lightDir), 0.0); 
     vec3 diffuse = diff * lightColor;
     
     float specularStrength = 0.5;
     
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(viewPos - fragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
     
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess); 
@@ -97,16 +114,16 @@ vec3 calculateDirLight(){
 
 vec3 calculateReflection(){
     float ratio = 1.00 / 1.52;
-	vec3 I = normalize(Position - viewPos); 
-	vec3 reflection = reflect(I, normalize(Normal)); 
+	vec3 I = normalize(position - viewPos); 
+	vec3 reflection = reflect(I, normal); 
     reflection = texture(skybox, reflection).rgb;
-	vec3 refraction = refract(I, normalize(Normal), ratio); //fr Refraction
+	vec3 refraction = refract(I, normal, ratio); //fr Refraction
     return reflection;
 }
 
 vec3 calculateGradient(){
     float maxHeight = 1000.0;
-    float height = (Position.x+maxHeight)/(2*maxHeight);
+    float height = (position.x+maxHeight)/(2*maxHeight);
 
     float angle = height * 360.0;
     vec3 color = calculateColor(angle);
@@ -115,7 +132,7 @@ vec3 calculateGradient(){
 
 vec3 calculateTimeGradient(){
     float maxLength = 1000.0;
-    float length = sqrt(Position.x*Position.x + Position.y*Position.y + Position.z*Position.z);
+    float length = sqrt(position.x*position.x + position.y*position.y + position.z*position.z);
 
     float distance = (length+maxLength)/maxLength - sqrt(sin(time/2)*sin(time/2))*1.5;
 
@@ -125,6 +142,27 @@ vec3 calculateTimeGradient(){
 }
 void main()
 {    
+    normal = normalize(Normal);
+    fragPos = FragPos;
+    position = Position;
+#ifdef IMPOSTOR
+    {
+        //First hit of the ray from the camera through the quad, depth and normal of the sphere instead of the quad
+        float radius = sphereRadius * scale;
+        vec3 dir = normalize(FragPos - viewPos);
+        vec3 oc = viewPos - Center;
+        float b = dot(oc, dir);
+        float h = b * b - dot(oc, oc) + radius * radius;
+        if (h < 0.0)
+            discard;
+        fragPos = viewPos + dir * (-b - sqrt(h));
+        position = fragPos;
+        normal = (fragPos - Center) / radius;
+        vec4 clip = projection * view * vec4(fragPos, 1.0);
+        gl_FragDepth = (gl_DepthRange.diff * clip.z / clip.w + gl_DepthRange.near + gl_DepthRange.far) * 0.5;
+    }
+#endif
+
     switch(shaderChoice){
         case 0: 
             vec3 result = calculateDirLight();
@@ -135,7 +173,7 @@ void main()
             FragColor = vec4(reflection, 1.0);
             break;
         case 2: 
-            FragColor = vec4(Position, 1.0f);
+            FragColor = vec4(position, 1.0f);
             break;
 
         case 3: 
@@ -151,7 +189,7 @@ void main()
         case 5: 
             vec3 shading;
 
-            float distance = sqrt(Position.x*Position.x + Position.y*Position.y + Position.z*Position.z);
+            float distance = sqrt(position.x*position.x + position.y*position.y + position.z*position.z);
 
             if(distance <= 200){
                 shading = calculateTimeGradient();
@@ -2,8 +2,8 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in mat4 instanceMatrix;
-layout (location = 7) in vec3 aColor;
+layout (location = 3) in vec3 instancePosition;
+layout (location = 4) in uint instanceColor; //Type or RGB8 with bit 31 set
 
 out vec2 TexCoords;
 out vec3 vColor;
@@ -11,16 +11,36 @@ out vec3 Normal;
 out vec3 FragPos;
 out vec3 Position;
 
-uniform mat4 view;
-uniform mat4 projection;
+//Per frame values shared by all programs, FrameUniforms of Simulation (std140)
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    vec3 dirLightDir;
+    vec3 dirLightColor;
+    vec3 lightPos;
+    vec3 lightColor;
+    float time;
+};
+
+uniform float scale;
+uniform vec3 typeColors[32]; //SimulationCore::MAX_TYPES
+uniform float meshScale;     //Fits the low poly sphere onto the sphere mesh (1 and 0 for the sphere mesh)
+uniform vec3 meshOffset;
 
 void main()
 {
     TexCoords = aTexCoords;    
-    gl_Position = projection * view * instanceMatrix * vec4(aPos, 1.0);
-    FragPos = vec3(instanceMatrix * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(instanceMatrix))) * aNormal;
-    vColor = aColor;
+    //Uniform scale and translation: the normals of the sphere stay unchanged
+    vec3 worldPos = (aPos * meshScale + meshOffset) * scale + instancePosition;
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+    FragPos = worldPos;
+    Normal = aNormal;
+    if ((instanceColor & 0x80000000u) != 0u)
+        vColor = vec3((instanceColor >> 16) & 0xFFu, (instanceColor >> 8) & 0xFFu, instanceColor & 0xFFu) / 255.0;
+    else
+        vColor = typeColors[min(instanceColor, 31u)];
     //fr Reflection
-    Position = vec3(instanceMatrix * vec4(aPos, 1.0)); 
+    Position = worldPos; 
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
 
 class Shader
 {
@@ -19,7 +20,8 @@ public:
     {
 
     }
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    // defines (e.g. "#define IMPOSTOR\n") are inserted after the #version line of every stage, so one file can build several programs
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const char* defines = nullptr)
     {
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
@@ -61,6 +63,12 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
         }
+        if (defines != nullptr)
+        {
+            vertexCode = insertDefines(vertexCode, defines);
+            fragmentCode = insertDefines(fragmentCode, defines);
+            geometryCode = insertDefines(geometryCode, defines);
+        }
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
@@ -93,6 +101,7 @@ public:
             glAttachShader(ID, geometry);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        cacheUniformLocations();
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -106,66 +115,161 @@ public:
     {
         glUseProgram(ID);
     }
+    // location of an active uniform from the cache, -1 (ignored by glUniform*) if the program has none of that name.
+    // uniforms set every frame keep it once after linking and use the setters taking a location
+    // ------------------------------------------------------------------------
+    int getUniformLocation(const std::string& name) const
+    {
+        std::unordered_map<std::string, int>::const_iterator it = locations.find(name);
+        return it != locations.end() ? it->second : -1;
+    }
+    // connects the uniform block of that name (if any) to a binding point of glBindBufferBase
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const std::string& name, unsigned int binding)
+    {
+        unsigned int index = glGetUniformBlockIndex(ID, name.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(getUniformLocation(name), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(getUniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(getUniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string& name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2fv(getUniformLocation(name), 1, &value[0]);
     }
     void setVec2(const std::string& name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(getUniformLocation(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string& name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(getUniformLocation(name), 1, &value[0]);
     }
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(getUniformLocation(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string& name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4fv(getUniformLocation(name), 1, &value[0]);
     }
     void setVec4(const std::string& name, float x, float y, float z, float w)
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(getUniformLocation(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string& name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+    }
+    // the same setters for a location kept from getUniformLocation: no string and no lookup, for uniforms set every frame
+    // ------------------------------------------------------------------------
+    void setBool(int location, bool value) const
+    {
+        glUniform1i(location, (int)value);
+    }
+    void setInt(int location, int value) const
+    {
+        glUniform1i(location, value);
+    }
+    void setFloat(int location, float value) const
+    {
+        glUniform1f(location, value);
+    }
+    void setVec2(int location, const glm::vec2& value) const
+    {
+        glUniform2fv(location, 1, &value[0]);
+    }
+    void setVec3(int location, const glm::vec3& value) const
+    {
+        glUniform3fv(location, 1, &value[0]);
+    }
+    void setVec4(int location, const glm::vec4& value) const
+    {
+        glUniform4fv(location, 1, &value[0]);
+    }
+    void setMat3(int location, const glm::mat3& mat) const
+    {
+        glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(int location, const glm::mat4& mat) const
+    {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    // uniform name -> location, filled once after linking so the setters never ask the driver
+    std::unordered_map<std::string, int> locations;
+
+    // every active uniform outside of uniform blocks, arrays under "name", "name[0]", "name[1]", ...
+    // ------------------------------------------------------------------------
+    void cacheUniformLocations()
+    {
+        locations.clear();
+        GLint count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLchar name[256];
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, (GLuint)i, sizeof(name), NULL, &size, &type, name);
+            GLint location = glGetUniformLocation(ID, name);
+            if (location < 0)
+                continue;
+            std::string uniform = name;
+            if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = uniform.substr(0, uniform.size() - 3);
+                locations[base] = location;
+                for (GLint element = 0; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    locations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+                }
+            }
+            else
+                locations[uniform] = location;
+        }
+    }
+    // defines go behind the first line, GLSL requires #version to come first
+    // ------------------------------------------------------------------------
+    static std::string insertDefines(const std::string& code, const char* defines)
+    {
+        if (code.empty())
+            return code;
+        size_t lineEnd = code.find('\n');
+        if (lineEnd == std::string::npos)
+            return code + "\n" + defines;
+        return code.substr(0, lineEnd + 1) + defines + code.substr(lineEnd + 1);
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
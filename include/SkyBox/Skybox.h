@@ -16,7 +16,7 @@ public:
 	this->initBuffer();
 	this->cubeMapTexture = this->loadCubeMap(faces);
 };
-	void render(Shader s, Camera camera, glm::mat4 projection){
+	void render(Shader& s, Camera camera, glm::mat4 projection){
 	//Skybox
 	glDepthFunc(GL_LEQUAL);
 	s.use();
@@ -0,0 +1,366 @@
+#include "SimulationCore.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ctime>
+#include <cstdlib>
+#include <algorithm>
+
+//Microbenchmarks of the simulation hot paths without window or GPU, results as JSON to compare builds
+
+struct BenchmarkOptions
+{
+	std::vector<int> counts;
+	std::vector<float> ratios;
+	std::vector<int> threads;
+	int typeCount;
+	float cubeSize;
+	float dt;
+	double minTime;
+	int maxIterations;
+	double maxPairs;
+	unsigned int seed;
+	std::string output;
+};
+
+//Seconds per call
+struct Measurement
+{
+	int iterations;
+	double mean;
+	double min;
+	double median;
+};
+
+static void printUsage(const char* name)
+{
+	std::cerr << "Usage: " << name << " [options]\n"
+		<< "  --counts LIST         particle counts (default 1000,10000,100000,1000000)\n"
+		<< "  --ratios LIST         distanceMax / cubeSize ratios (default 0.05,0.15,0.3)\n"
+		<< "  --threads LIST        thread counts, 0 = all hardware threads (default 1,2,4,0)\n"
+		<< "  --types N             number of types (default 5)\n"
+		<< "  --box F               half edge length of the border box (default 250)\n"
+		<< "  --dt F                time per step in seconds (default 0.016)\n"
+		<< "  --min-time F          seconds measured per case at least (default 0.5)\n"
+		<< "  --max-iterations N    calls per case at most (default 100)\n"
+		<< "  --max-pairs F         skip step cases with more expected pairs per step (default 2e9)\n"
+		<< "  --seed N              random seed (default 42)\n"
+		<< "  --output F            write the JSON into a file instead of stdout\n";
+}
+
+template <class T>
+static bool parseList(const std::string& text, std::vector<T>& values)
+{
+	values.clear();
+	std::string cleaned = text;
+	std::replace(cleaned.begin(), cleaned.end(), ',', ' ');
+	std::istringstream stream(cleaned);
+	T value;
+	while (stream >> value)
+	{
+		values.push_back(value);
+	}
+	return !values.empty() && stream.eof();
+}
+
+static bool parseArgs(int argc, char** argv, BenchmarkOptions& o)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h")
+		{
+			return false;
+		}
+		else if (i + 1 >= argc)
+		{
+			std::cerr << "Missing value for " << arg << std::endl;
+			return false;
+		}
+		else if (arg == "--counts")
+		{
+			if (!parseList(argv[++i], o.counts))
+			{
+				return false;
+			}
+		}
+		else if (arg == "--ratios")
+		{
+			if (!parseList(argv[++i], o.ratios))
+			{
+				return false;
+			}
+		}
+		else if (arg == "--threads")
+		{
+			if (!parseList(argv[++i], o.threads))
+			{
+				return false;
+			}
+		}
+		else if (arg == "--types")
+		{
+			o.typeCount = atoi(argv[++i]);
+		}
+		else if (arg == "--box")
+		{
+			o.cubeSize = (float)atof(argv[++i]);
+		}
+		else if (arg == "--dt")
+		{
+			o.dt = (float)atof(argv[++i]);
+		}
+		else if (arg == "--min-time")
+		{
+			o.minTime = atof(argv[++i]);
+		}
+		else if (arg == "--max-iterations")
+		{
+			o.maxIterations = atoi(argv[++i]);
+		}
+		else if (arg == "--max-pairs")
+		{
+			o.maxPairs = atof(argv[++i]);
+		}
+		else if (arg == "--seed")
+		{
+			o.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		}
+		else if (arg == "--output")
+		{
+			o.output = argv[++i];
+		}
+		else
+		{
+			std::cerr << "Unknown option " << arg << std::endl;
+			return false;
+		}
+	}
+
+	bool valid = o.typeCount >= 1 && o.typeCount <= SimulationCore::MAX_TYPES && o.cubeSize > 0.0f && o.dt > 0.0f && o.minTime >= 0.0 && o.maxIterations >= 1;
+	for (int count : o.counts)
+	{
+		valid = valid && count >= o.typeCount;
+	}
+	for (float ratio : o.ratios)
+	{
+		valid = valid && ratio > 0.0f;
+	}
+	for (int threads : o.threads)
+	{
+		valid = valid && threads >= 0;
+	}
+	if (!valid)
+	{
+		std::cerr << "Invalid option value" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+template <class Function>
+static Measurement measure(Function function, double minTime, int maxIterations)
+{
+	//At least one call, then until minTime is reached
+	std::vector<double> times;
+	double total = 0.0;
+	while ((int)times.size() < maxIterations && (times.empty() || total < minTime))
+	{
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		function();
+		double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		times.push_back(time);
+		total += time;
+	}
+
+	Measurement m;
+	m.iterations = (int)times.size();
+	m.mean = total / times.size();
+	std::sort(times.begin(), times.end());
+	m.min = times.front();
+	m.median = times[times.size() / 2];
+	return m;
+}
+
+//Common fields of a result, the caller appends its own and closes the object
+static std::string result(const char* benchmark, int particles, int threads, const Measurement& m)
+{
+	std::ostringstream json;
+	json << "    {\"benchmark\": \"" << benchmark << "\", \"particles\": " << particles << ", \"threads\": " << threads
+		<< ", \"iterations\": " << m.iterations << ", \"meanMs\": " << m.mean * 1000.0 << ", \"minMs\": " << m.min * 1000.0
+		<< ", \"medianMs\": " << m.median * 1000.0;
+	return json.str();
+}
+
+static std::string currentDate()
+{
+	char text[32];
+	time_t now = time(0);
+	strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+	return text;
+}
+
+static std::string compilerName()
+{
+	std::ostringstream name;
+#if defined(_MSC_VER)
+	name << "MSVC " << _MSC_VER;
+#elif defined(__clang__)
+	name << "Clang " << __clang_major__ << "." << __clang_minor__;
+#elif defined(__GNUC__)
+	name << "GCC " << __GNUC__ << "." << __GNUC_MINOR__;
+#else
+	name << "unknown";
+#endif
+	return name.str();
+}
+
+int main(int argc, char** argv)
+{
+	BenchmarkOptions o;
+	parseList<int>("1000,10000,100000,1000000", o.counts);
+	parseList<float>("0.05,0.15,0.3", o.ratios);
+	parseList<int>("1,2,4,0", o.threads);
+	o.typeCount = 5;
+	o.cubeSize = 250.0f;
+	o.dt = 0.016f;
+	o.minTime = 0.5;
+	o.maxIterations = 100;
+	o.maxPairs = 2e9;
+	o.seed = 42;
+
+	if (!parseArgs(argc, argv, o))
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	//0 = all hardware threads, every thread count once
+	const int hardwareThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	std::vector<int> threadCounts;
+	for (int threads : o.threads)
+	{
+		threads = threads == 0 ? hardwareThreads : threads;
+		if (std::find(threadCounts.begin(), threadCounts.end(), threads) == threadCounts.end())
+		{
+			threadCounts.push_back(threads);
+		}
+	}
+
+	std::vector<std::string> results;
+	SimdLevel simdLevel = SIMD_SCALAR;
+	const BoundaryMode boundaries[] = { BOUNDARY_REFLECTIVE, BOUNDARY_PERIODIC, BOUNDARY_NONE };
+	for (int count : o.counts)
+	{
+		for (int threads : threadCounts)
+		{
+			srand(o.seed);
+			SimulationCore core(count / o.typeCount, o.typeCount, threads);
+			core.settings.cubeSize = o.cubeSize;
+			core.randomPosition();
+			simdLevel = core.getSimdLevel();
+			const int n = core.getParticles().size();
+
+			//Whole step with its phases
+			for (float ratio : o.ratios)
+			{
+				//Particles within distanceMax of a particle in a homogeneous box
+				const float distanceMax = ratio * o.cubeSize;
+				const double volume = 4.18879 * distanceMax * distanceMax * distanceMax / (8.0 * o.cubeSize * o.cubeSize * o.cubeSize);
+				const double pairs = (double)n * n * std::min(1.0, volume);
+				if (pairs > o.maxPairs)
+				{
+					std::cerr << "Skipped step: " << n << " particles, ratio " << ratio << " (" << pairs << " pairs)" << std::endl;
+					continue;
+				}
+				core.settings.distanceMax = distanceMax;
+				core.settings.boundary = BOUNDARY_REFLECTIVE;
+
+				//Kernels and integration compiled for the settings against the generic path with runtime checks, both from the same positions
+				for (bool specialized : { true, false })
+				{
+					std::cerr << "Step: " << n << " particles, " << threads << " threads, ratio " << ratio << ", " << (specialized ? "specialized" : "generic") << " kernels" << std::endl;
+					core.settings.specializedKernels = specialized;
+					srand(o.seed);
+					core.randomPosition();
+					core.step(o.dt);
+					core.step(o.dt);
+
+					StepTimings phases = StepTimings();
+					Measurement m = measure([&core, &phases, &o]() {
+						core.step(o.dt);
+						StepTimings t = core.getStepTimings();
+						phases.reorder += t.reorder;
+						phases.neighbours += t.neighbours;
+						phases.interaction += t.interaction;
+						phases.integration += t.integration;
+					}, o.minTime, o.maxIterations);
+
+					NeighbourListStats stats = core.getNeighbourStats();
+					std::ostringstream json;
+					json << result("step", n, threads, m) << ", \"distanceMax\": " << distanceMax << ", \"cubeSize\": " << o.cubeSize << ", \"ratio\": " << ratio
+						<< ", \"kernels\": \"" << (specialized ? "specialized" : "generic") << "\""
+						<< ", \"reorderMs\": " << phases.reorder * 1000.0 / m.iterations << ", \"neighboursMs\": " << phases.neighbours * 1000.0 / m.iterations
+						<< ", \"interactionMs\": " << phases.interaction * 1000.0 / m.iterations << ", \"integrationMs\": " << phases.integration * 1000.0 / m.iterations
+						<< ", \"neighboursPerParticle\": " << stats.averageLength << "}";
+					results.push_back(json.str());
+				}
+				core.settings.specializedKernels = true;
+			}
+
+			//Integration and borders alone, forces of the last step
+			std::cerr << "Integration: " << n << " particles, " << threads << " threads" << std::endl;
+			for (BoundaryMode boundary : boundaries)
+			{
+				core.settings.boundary = boundary;
+				Measurement m = measure([&core, &o]() {
+					core.integrateStep(o.dt);
+				}, o.minTime, o.maxIterations);
+				results.push_back(result("integration", n, threads, m) + ", \"boundary\": \"" + getBoundaryName(boundary) + "\"}");
+			}
+
+			//Instance data as built for the renderer
+			std::vector<ParticleInstance> instanceData(n);
+			Life3D_Particles& particles = core.getParticles();
+			Measurement instances = measure([&core, &particles, &instanceData]() {
+				core.getThreadPool()->parallelFor(0, particles.size(), 4096, [&particles, &instanceData](int begin, int end, int worker) {
+					particles.update(&instanceData[0], begin, end);
+				});
+			}, o.minTime, o.maxIterations);
+			results.push_back(result("instances", n, threads, instances) + "}");
+
+			//Serial, measured once per count
+			if (threads == threadCounts.front())
+			{
+				Measurement random = measure([&core]() {
+					core.randomPosition();
+				}, o.minTime, o.maxIterations);
+				results.push_back(result("randomPosition", n, 1, random) + "}");
+			}
+		}
+	}
+
+	std::ofstream file;
+	if (!o.output.empty())
+	{
+		file.open(o.output);
+		if (!file)
+		{
+			std::cerr << "Could not open " << o.output << std::endl;
+			return 1;
+		}
+	}
+	std::ostream& json = o.output.empty() ? std::cout : file;
+	json << "{\n  \"simd\": \"" << getSimdName(simdLevel) << "\",\n  \"hardwareThreads\": " << hardwareThreads << ",\n  \"compiler\": \"" << compilerName()
+		<< "\",\n  \"date\": \"" << currentDate() << "\",\n  \"types\": " << o.typeCount << ",\n  \"dt\": " << o.dt << ",\n  \"results\": [\n";
+	for (int i = 0; i < (int)results.size(); i++)
+	{
+		json << results[i] << (i + 1 < (int)results.size() ? ",\n" : "\n");
+	}
+	json << "  ]\n}\n";
+	return 0;
+}
@@ -8,14 +8,29 @@ Engine::Engine()
 void Engine::run()
 {
 	//Main loop (Exit on ESC or Cross)
+	Profiler::setThreadName("Main");
 	while (!glfwWindowShouldClose(this->window))
 	{
-		this->update();
-		this->render();
-		glfwSwapBuffers(this->window);
+		{
+			ProfileScope scope("Update");
+			this->update();
+		}
+		{
+			ProfileScope scope("Render");
+			this->render();
+		}
+		{
+			//Waits for the GPU if it is behind
+			ProfileScope scope("SwapBuffers");
+			glfwSwapBuffers(this->window);
+		}
 		glfwPollEvents();
+		Profiler::endFrame();
 	}
 
+	//Stops the simulation thread before its window goes away
+	delete this->simulation;
+
 	//ImGUI Cleanup
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
@@ -29,9 +44,13 @@ void Engine::initVariables()
 	std::cout << "Eingabe Anzahl Partikel pro Typ: ";
 	std::cin >> amount;
 
+	int typeCount = 5;
+	std::cout << "Eingabe Anzahl Typen: ";
+	std::cin >> typeCount;
+
 	this->windowHandler = new WindowHandler();
 	this->window = this->windowHandler->getWindow();
-	this->simulation = new Simulation(this->window, this->windowHandler->getWindowSize().x, this->windowHandler->getWindowSize().y, amount);
+	this->simulation = new Simulation(this->window, this->windowHandler->getWindowSize().x, this->windowHandler->getWindowSize().y, amount, typeCount);
 }
 
 void Engine::update()
@@ -0,0 +1,183 @@
+#include "ForceKernel.h"
+#include <cmath>
+
+#if defined(_MSC_VER) && defined(LIFE3D_X86)
+#include <intrin.h>
+#elif defined(LIFE3D_X86)
+#include <cpuid.h>
+#endif
+
+//1 lane fallback for CPUs without SSE (or non x86 builds)
+struct ScalarOps
+{
+	typedef float V;
+	typedef bool M;
+	typedef int I;
+	static const int WIDTH = 1;
+
+	static inline V set1(float v) { return v; }
+	static inline V load(const float* p) { return *p; }
+	static inline void store(float* p, V v) { *p = v; }
+	static inline V add(V a, V b) { return a + b; }
+	static inline V sub(V a, V b) { return a - b; }
+	static inline V mul(V a, V b) { return a * b; }
+	static inline V abs(V a) { return std::fabs(a); }
+
+	static inline M less(V a, V b) { return a < b; }
+	static inline M greater(V a, V b) { return a > b; }
+	static inline M andMask(M a, M b) { return a && b; }
+	static inline M firstN(int n) { return n > 0; }
+	static inline V select(M m, V a, V b) { return m ? a : b; }
+
+	static inline V rsqrt(V v) { return 1.0f / std::sqrt(v); }
+	static inline V gather(const float* base, const int* index) { return base[*index]; }
+	static inline V lookup(const float* row, const int* index, int count) { return row[*index]; }
+
+	static inline I loadInt(const int* p) { return *p; }
+	static inline I toInt(V v) { return (int)v; }
+	static inline V toFloat(I i) { return (float)i; }
+
+	static inline void loadRecords(const float* base, I index, V& c0, V& c1, V& c2, V& c3)
+	{
+		const float* r = base + 4 * index;
+		c0 = r[0];
+		c1 = r[1];
+		c2 = r[2];
+		c3 = r[3];
+	}
+
+	static inline float sum(V v) { return v; }
+	static inline void finish() {}
+};
+
+#include "ForceKernel.inl"
+
+ForceKernelFunc selectForceKernelScalar(const ForceKernelArgs& args, bool generic)
+{
+	return selectForceKernelImpl<ScalarOps>(args, generic);
+}
+
+PairKernelFunc selectPairKernelScalar(const ForceKernelArgs& args, bool generic)
+{
+	return selectPairKernelImpl<ScalarOps>(args, generic);
+}
+
+//CPUID------------------------------------------------------------------------------
+
+#ifdef LIFE3D_X86
+static void cpuid(int leaf, int subleaf, unsigned int regs[4])
+{
+#ifdef _MSC_VER
+	int r[4];
+	__cpuidex(r, leaf, subleaf);
+	for (int i = 0; i < 4; i++)
+	{
+		regs[i] = (unsigned int)r[i];
+	}
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned long long xgetbv()
+{
+	//Which register states the OS saves on context switches
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+#endif
+
+SimdLevel detectSimdLevel()
+{
+#ifdef LIFE3D_X86
+	unsigned int regs[4];
+	cpuid(0, 0, regs);
+	unsigned int maxLeaf = regs[0];
+
+	cpuid(1, 0, regs);
+	bool sse2 = (regs[3] & (1u << 26)) != 0;
+	bool osxsave = (regs[2] & (1u << 27)) != 0;
+	bool avx = (regs[2] & (1u << 28)) != 0;
+	if (!sse2)
+	{
+		return SIMD_SCALAR;
+	}
+	if (!osxsave || !avx || maxLeaf < 7)
+	{
+		return SIMD_SSE;
+	}
+
+	unsigned long long xcr0 = xgetbv();
+	cpuid(7, 0, regs);
+	bool avx2 = (regs[1] & (1u << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+	bool avx512 = (regs[1] & (1u << 16)) != 0 && (xcr0 & 0xE6) == 0xE6;
+
+	if (avx512)
+	{
+		return SIMD_AVX512;
+	}
+	if (avx2)
+	{
+		return SIMD_AVX2;
+	}
+	return SIMD_SSE;
+#else
+	return SIMD_SCALAR;
+#endif
+}
+
+const char* getSimdName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SIMD_SSE:
+		return "SSE";
+	case SIMD_AVX2:
+		return "AVX2";
+	case SIMD_AVX512:
+		return "AVX-512";
+	default:
+		return "Scalar";
+	}
+}
+
+ForceKernelFunc getForceKernel(SimdLevel level, const ForceKernelArgs& args, bool generic)
+{
+#ifdef LIFE3D_X86
+	switch (level)
+	{
+	case SIMD_SSE:
+		return selectForceKernelSSE(args, generic);
+	case SIMD_AVX2:
+		return selectForceKernelAVX2(args, generic);
+	case SIMD_AVX512:
+		return selectForceKernelAVX512(args, generic);
+	default:
+		break;
+	}
+#endif
+	return selectForceKernelScalar(args, generic);
+}
+
+PairKernelFunc getPairKernel(SimdLevel level, const ForceKernelArgs& args, bool generic)
+{
+#ifdef LIFE3D_X86
+	switch (level)
+	{
+	case SIMD_SSE:
+		return selectPairKernelSSE(args, generic);
+	case SIMD_AVX2:
+		return selectPairKernelAVX2(args, generic);
+	case SIMD_AVX512:
+		return selectPairKernelAVX512(args, generic);
+	default:
+		break;
+	}
+#endif
+	return selectPairKernelScalar(args, generic);
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LIFE3D_X86
+#endif
+
+//Instruction sets the pairwise force kernel is compiled for, the best supported one is picked at runtime via CPUID
+enum SimdLevel
+{
+	SIMD_SCALAR,
+	SIMD_SSE,
+	SIMD_AVX2,
+	SIMD_AVX512
+};
+
+//How the force between two particles is evaluated
+enum ForceLaw
+{
+	FORCE_FORMULA,      //Piecewise linear formula with the attraction matrix
+	FORCE_TABLE_LINEAR, //Sampled per type pair (ForceTable), linear between the samples
+	FORCE_TABLE_CUBIC   //Same samples, cubic (Catmull-Rom) between them
+};
+
+//Everything the kernel reads and writes as plain pointers, the instruction set specific translation units include nothing else
+struct ForceKernelArgs
+{
+	//Particle data in grid order (padded, see SpatialGrid::PADDING)
+	const float* x;
+	const float* y;
+	const float* z;
+	const int* type;
+	const int* sortedIndex;
+
+	//Grid
+	const int* bucketStart;
+	int cellsPerAxis;
+	float cubeSize;
+	float invCellSize;
+
+	//Edge length of the box for periodic boundaries (minimum image distances, wrapped cells), 0 otherwise
+	float period;
+
+	//Verlet lists in CSR layout over grid order (NULL: search the 27 surrounding cells instead)
+	const int* neighbourStart;
+	const int* neighbours;
+	const int* neighbourTypes;
+
+	//Interaction, both matrices are followed by ROW_PADDING readable floats (a row can be loaded into registers as a whole)
+	const float* attraction; //typeCount * typeCount, row = type of the particle receiving the force
+	const float* attractionTransposed; //Same matrix, row = type of the particle exerting the force (pair kernel)
+	int typeCount;
+	float distanceMax;
+
+	//Force law, beta is the end of the repulsion (formula), tables are records of 4 coefficients [type][type][segment] (see ForceTable)
+	ForceLaw forceLaw;
+	float beta;
+	const float* forceTable;
+	const float* forceTableTransposed;
+
+	//Output, indexed by particle index (not grid order)
+	float* forceX;
+	float* forceY;
+	float* forceZ;
+
+	static const int ROW_PADDING = 32;
+	static const int TABLE_SEGMENTS = 64;
+};
+
+//Cell walk shared by the kernels and the neighbour list build------------------------------------------------------------------------------
+
+//Distinct neighbour cell coordinates of c on one axis, wrapped around for periodic boundaries. Returns the count (at most 3).
+static inline int neighbourCells(int c, int cells, bool periodic, int out[3])
+{
+	int count = 0;
+	if (periodic && cells >= 3)
+	{
+		out[count++] = c > 0 ? c - 1 : cells - 1;
+		out[count++] = c;
+		out[count++] = c < cells - 1 ? c + 1 : 0;
+	}
+	else if (periodic)
+	{
+		//Less than 3 cells: every cell is a neighbour, but only once
+		for (int i = 0; i < cells; i++)
+		{
+			out[count++] = i;
+		}
+	}
+	else
+	{
+		for (int i = (c > 0 ? c - 1 : 0); i <= (c < cells - 1 ? c + 1 : cells - 1); i++)
+		{
+			out[count++] = i;
+		}
+	}
+	return count;
+}
+
+//Neighbour cells of c in x direction as at most 2 contiguous spans [first, last], so a row can be walked as one or two ranges. Returns the span count.
+static inline int neighbourSpans(int c, int cells, bool periodic, int first[2], int last[2])
+{
+	if (periodic && cells >= 3 && c == 0)
+	{
+		first[0] = 0;
+		last[0] = 1;
+		first[1] = cells - 1;
+		last[1] = cells - 1;
+		return 2;
+	}
+	if (periodic && cells >= 3 && c == cells - 1)
+	{
+		first[0] = cells - 2;
+		last[0] = cells - 1;
+		first[1] = 0;
+		last[1] = 0;
+		return 2;
+	}
+	if (periodic && cells < 3)
+	{
+		first[0] = 0;
+		last[0] = cells - 1;
+		return 1;
+	}
+	first[0] = c > 0 ? c - 1 : 0;
+	last[0] = c < cells - 1 ? c + 1 : cells - 1;
+	return 1;
+}
+
+//Computes the forces of the particles [begin, end) in grid order
+typedef void (*ForceKernelFunc)(const ForceKernelArgs& args, int begin, int end);
+
+//Half shell (every pair once): adds the forces of the pairs of [begin, end) to both particles in the accumulators (grid order, without the distanceMax factor).
+//Uses the cells, not the neighbour lists, periodic boxes need at least 3 cells per axis.
+typedef void (*PairKernelFunc)(const ForceKernelArgs& args, int begin, int end, float* accX, float* accY, float* accZ);
+
+SimdLevel detectSimdLevel();
+const char* getSimdName(SimdLevel level);
+
+//Kernel variant for the current arguments (boundary, force law, type count, lists or cells), picked once per step.
+//generic: the variant that reads boundary and type count at run time, for types without an own variant and for comparison.
+ForceKernelFunc getForceKernel(SimdLevel level, const ForceKernelArgs& args, bool generic);
+PairKernelFunc getPairKernel(SimdLevel level, const ForceKernelArgs& args, bool generic);
+
+ForceKernelFunc selectForceKernelScalar(const ForceKernelArgs& args, bool generic);
+#ifdef LIFE3D_X86
+ForceKernelFunc selectForceKernelSSE(const ForceKernelArgs& args, bool generic);
+ForceKernelFunc selectForceKernelAVX2(const ForceKernelArgs& args, bool generic);
+ForceKernelFunc selectForceKernelAVX512(const ForceKernelArgs& args, bool generic);
+#endif
+
+PairKernelFunc selectPairKernelScalar(const ForceKernelArgs& args, bool generic);
+#ifdef LIFE3D_X86
+PairKernelFunc selectPairKernelSSE(const ForceKernelArgs& args, bool generic);
+PairKernelFunc selectPairKernelAVX2(const ForceKernelArgs& args, bool generic);
+PairKernelFunc selectPairKernelAVX512(const ForceKernelArgs& args, bool generic);
+#endif
+
@@ -0,0 +1,639 @@
+//Generic pairwise force kernel, included by the instruction set specific translation units.
+//Ops provides the vector type V, the mask type M and the operations for one instruction set (see ForceKernel_*.cpp).
+//Every lane handles one neighbour, the piecewise force is evaluated with masks instead of branches, tables with one record load per lane.
+
+static inline int kernelCellCoord(const ForceKernelArgs& a, float p)
+{
+	//Same clamping as SpatialGrid::cellCoord
+	int c = (int)((p + a.cubeSize) * a.invCellSize);
+	return c < 0 ? 0 : (c > a.cellsPerAxis - 1 ? a.cellsPerAxis - 1 : c);
+}
+
+//Constants shared by all force laws, set up once per call
+template <class Ops>
+struct KernelConstants
+{
+	typedef typename Ops::V V;
+
+	V one;
+	V zero;
+	V invDistanceMax;
+	V period;
+	V halfPeriod;
+	V minusHalfPeriod;
+
+	KernelConstants(float distanceMax, float period)
+	{
+		this->one = Ops::set1(1.0f);
+		this->zero = Ops::set1(0.0f);
+		this->invDistanceMax = Ops::set1(1.0f / distanceMax);
+		this->period = Ops::set1(period);
+		this->halfPeriod = Ops::set1(0.5f * period);
+		this->minusHalfPeriod = Ops::set1(-0.5f * period);
+	}
+};
+
+//Boundary policies of the kernels: whether distances and the cell walk wrap around (reflective and open boxes are the same here)
+struct OpenBox
+{
+	static inline bool periodic(const ForceKernelArgs& a) { return false; }
+};
+
+struct PeriodicBox
+{
+	static inline bool periodic(const ForceKernelArgs& a) { return true; }
+};
+
+//Generic path: read from the arguments on every call
+struct RuntimeBox
+{
+	static inline bool periodic(const ForceKernelArgs& a) { return a.period > 0.0f; }
+};
+
+//Minimum image: the nearest copy of the neighbour in the periodic box (offsets are at most one period off)
+template <class Ops>
+static inline typename Ops::V minimumImage(const KernelConstants<Ops>& c, typename Ops::V d, bool periodic)
+{
+	if (periodic)
+	{
+		d = Ops::select(Ops::greater(d, c.halfPeriod), Ops::sub(d, c.period), d);
+		d = Ops::select(Ops::less(d, c.minusHalfPeriod), Ops::add(d, c.period), d);
+	}
+	return d;
+}
+
+//Normalized distance of WIDTH neighbours, shared by both directions of a pair
+template <class Ops>
+struct PairDistance
+{
+	typedef typename Ops::V V;
+	typedef typename Ops::M M;
+
+	V invDistance;
+	V d; //distance / distanceMax
+	M valid;
+
+	PairDistance(const KernelConstants<Ops>& c, V d2, M validMask)
+	{
+		//The particle itself (distance 0) does not contribute
+		this->valid = Ops::andMask(validMask, Ops::greater(d2, c.zero));
+		this->invDistance = Ops::rsqrt(Ops::select(this->valid, d2, c.one));
+		this->d = Ops::mul(Ops::mul(d2, this->invDistance), c.invDistanceMax);
+	}
+};
+
+//Force laws------------------------------------------------------------------------------
+//setParticle selects the particle whose neighbours follow, scale returns force / distance for it (times the offset it gives the force vector),
+//scalePair additionally the force / distance of the neighbours (pair kernels).
+//Types > 0 fixes the type count at compile time (row offsets and lookups become constants), 0 reads it from the arguments.
+
+//Piecewise formula: repulsion below beta, attraction tent scaled by the attraction matrix up to distanceMax
+template <class Ops, int Types>
+struct FormulaForce
+{
+	typedef typename Ops::V V;
+	static const int TYPES = Types;
+
+	V beta;
+	V invBeta;
+	V onePlusBeta;
+	V invOneMinusBeta;
+	V one;
+	V two;
+	V zero;
+
+	const float* attraction;
+	const float* attractionTransposed;
+	const float* row;
+	const float* column;
+	int types;
+
+	FormulaForce(const ForceKernelArgs& a)
+	{
+		//Force function to prevent particles from collapsing into singularity @Tom Mohr
+		this->beta = Ops::set1(a.beta);
+		this->invBeta = Ops::set1(1.0f / a.beta);
+		this->onePlusBeta = Ops::set1(1.0f + a.beta);
+		this->invOneMinusBeta = Ops::set1(1.0f / (1.0f - a.beta));
+		this->one = Ops::set1(1.0f);
+		this->two = Ops::set1(2.0f);
+		this->zero = Ops::set1(0.0f);
+
+		this->attraction = a.attraction;
+		this->attractionTransposed = a.attractionTransposed;
+		this->row = a.attraction;
+		this->column = a.attractionTransposed;
+		this->types = Types > 0 ? Types : a.typeCount;
+	}
+
+	void setParticle(int type)
+	{
+		this->row = this->attraction + type * this->types;
+		this->column = this->attractionTransposed + type * this->types;
+	}
+
+	V scale(const PairDistance<Ops>& p, const int* neighbourType) const
+	{
+		V repulsion;
+		V tent;
+		this->terms(p, repulsion, tent);
+		return this->combine(p, repulsion, tent, Ops::lookup(this->row, neighbourType, this->types));
+	}
+
+	void scalePair(const PairDistance<Ops>& p, const int* neighbourType, V& particle, V& neighbour) const
+	{
+		//Same shape for both, only the attraction factor differs
+		V repulsion;
+		V tent;
+		this->terms(p, repulsion, tent);
+		particle = this->combine(p, repulsion, tent, Ops::lookup(this->row, neighbourType, this->types));
+		neighbour = this->combine(p, repulsion, tent, Ops::lookup(this->column, neighbourType, this->types));
+	}
+
+	void terms(const PairDistance<Ops>& p, V& repulsion, V& tent) const
+	{
+		repulsion = Ops::sub(Ops::mul(p.d, this->invBeta), this->one);
+		tent = Ops::sub(this->one, Ops::mul(Ops::abs(Ops::sub(Ops::mul(this->two, p.d), this->onePlusBeta)), this->invOneMinusBeta));
+	}
+
+	V combine(const PairDistance<Ops>& p, V repulsion, V tent, V attractionFactor) const
+	{
+		//d < beta: repulsion, beta < d < 1: attraction tent, else 0
+		V f = Ops::select(Ops::andMask(Ops::greater(p.d, this->beta), Ops::less(p.d, this->one)), Ops::mul(attractionFactor, tent), this->zero);
+		f = Ops::select(Ops::less(p.d, this->beta), repulsion, f);
+		f = Ops::select(p.valid, f, this->zero);
+		return Ops::mul(f, p.invDistance);
+	}
+};
+
+//Sampled force per type pair (see ForceTable): TABLE_SEGMENTS polynomial segments over d in [0, 1), linear or cubic.
+//The coefficients of a segment are one 16 byte record, every lane loads its record at once instead of gathering each coefficient.
+template <class Ops, bool Cubic, int Types>
+struct TableForce
+{
+	typedef typename Ops::V V;
+	typedef typename Ops::I I;
+	static const int TYPES = Types;
+
+	V segments;
+	V zero;
+	V one;
+
+	//Records [type][type][segment]
+	const float* table;
+	const float* transposed;
+	const float* row;
+	const float* column;
+	int rowSize;
+
+	TableForce(const ForceKernelArgs& a)
+	{
+		this->segments = Ops::set1((float)ForceKernelArgs::TABLE_SEGMENTS);
+		this->zero = Ops::set1(0.0f);
+		this->one = Ops::set1(1.0f);
+
+		this->table = a.forceTable;
+		this->transposed = a.forceTableTransposed;
+		this->row = this->table;
+		this->column = this->transposed;
+		this->rowSize = (Types > 0 ? Types : a.typeCount) * ForceKernelArgs::TABLE_SEGMENTS * 4;
+	}
+
+	void setParticle(int type)
+	{
+		this->row = this->table + type * this->rowSize;
+		this->column = this->transposed + type * this->rowSize;
+	}
+
+	//Record index (neighbour type * segments + segment) and position t in [0, 1) inside the segment
+	void locate(const PairDistance<Ops>& p, const int* neighbourType, I& index, V& t) const
+	{
+		//Lanes outside of [0, 1) read segment 0, their result is masked anyway
+		V x = Ops::mul(p.d, this->segments);
+		x = Ops::select(Ops::andMask(p.valid, Ops::less(p.d, this->one)), x, this->zero);
+		const V segment = Ops::toFloat(Ops::toInt(x));
+		t = Ops::sub(x, segment);
+		index = Ops::toInt(Ops::add(Ops::mul(Ops::toFloat(Ops::loadInt(neighbourType)), this->segments), segment));
+	}
+
+	V finish(const PairDistance<Ops>& p, V f) const
+	{
+		f = Ops::select(Ops::andMask(p.valid, Ops::less(p.d, this->one)), f, this->zero);
+		return Ops::mul(f, p.invDistance);
+	}
+
+	V cubic(V c0, V c1, V c2, V c3, V t) const
+	{
+		//Horner: c0 + t * (c1 + t * (c2 + t * c3))
+		return Ops::add(c0, Ops::mul(t, Ops::add(c1, Ops::mul(t, Ops::add(c2, Ops::mul(t, c3))))));
+	}
+
+	V scale(const PairDistance<Ops>& p, const int* neighbourType) const
+	{
+		I index;
+		V t;
+		V c0, c1, c2, c3;
+		this->locate(p, neighbourType, index, t);
+		Ops::loadRecords(this->row, index, c0, c1, c2, c3);
+		if (Cubic)
+		{
+			return this->finish(p, this->cubic(c0, c1, c2, c3, t));
+		}
+		return this->finish(p, Ops::add(c0, Ops::mul(t, c1)));
+	}
+
+	void scalePair(const PairDistance<Ops>& p, const int* neighbourType, V& particle, V& neighbour) const
+	{
+		I index;
+		V t;
+		V c0, c1, c2, c3;
+		this->locate(p, neighbourType, index, t);
+		Ops::loadRecords(this->row, index, c0, c1, c2, c3);
+		if (Cubic)
+		{
+			particle = this->finish(p, this->cubic(c0, c1, c2, c3, t));
+			Ops::loadRecords(this->column, index, c0, c1, c2, c3);
+			neighbour = this->finish(p, this->cubic(c0, c1, c2, c3, t));
+		}
+		else
+		{
+			//Linear records hold both directions of the pair
+			particle = this->finish(p, Ops::add(c0, Ops::mul(t, c1)));
+			neighbour = this->finish(p, Ops::add(c2, Ops::mul(t, c3)));
+		}
+	}
+};
+
+//Adds the forces of WIDTH neighbours at offset (dx, dy, dz), lanes outside of valid do not contribute
+template <class Ops, class Force>
+static inline void accumulateForce(const KernelConstants<Ops>& c, const Force& force, typename Ops::V dx, typename Ops::V dy, typename Ops::V dz, const int* neighbourType,
+	typename Ops::M valid, typename Ops::V& fx, typename Ops::V& fy, typename Ops::V& fz)
+{
+	typedef typename Ops::V V;
+
+	const V d2 = Ops::add(Ops::add(Ops::mul(dx, dx), Ops::mul(dy, dy)), Ops::mul(dz, dz));
+	const V s = force.scale(PairDistance<Ops>(c, d2, valid), neighbourType);
+	fx = Ops::add(fx, Ops::mul(s, dx));
+	fy = Ops::add(fy, Ops::mul(s, dy));
+	fz = Ops::add(fz, Ops::mul(s, dz));
+}
+
+//Kernels------------------------------------------------------------------------------
+
+//Neighbours from the 27 surrounding cells, contiguous loads
+template <class Ops, class Boundary, class Force>
+static void computeForcesCellsImpl(const ForceKernelArgs& a, int begin, int end)
+{
+	typedef typename Ops::V V;
+
+	const KernelConstants<Ops> c(a.distanceMax, a.period);
+	Force force(a);
+	const bool periodic = Boundary::periodic(a);
+	const int cells = a.cellsPerAxis;
+	const int types = Force::TYPES > 0 ? Force::TYPES : a.typeCount;
+
+	for (int i = begin; i < end; i++)
+	{
+		const float px = a.x[i];
+		const float py = a.y[i];
+		const float pz = a.z[i];
+		const V vx = Ops::set1(px);
+		const V vy = Ops::set1(py);
+		const V vz = Ops::set1(pz);
+		force.setParticle(a.type[i]);
+
+		V fx = c.zero;
+		V fy = c.zero;
+		V fz = c.zero;
+
+		int cellY[3];
+		int cellZ[3];
+		int spanFirst[2];
+		int spanLast[2];
+		const int countY = neighbourCells(kernelCellCoord(a, py), cells, periodic, cellY);
+		const int countZ = neighbourCells(kernelCellCoord(a, pz), cells, periodic, cellZ);
+		const int spans = neighbourSpans(kernelCellCoord(a, px), cells, periodic, spanFirst, spanLast);
+
+		for (int iz = 0; iz < countZ; iz++)
+		{
+			for (int iy = 0; iy < countY; iy++)
+			{
+				for (int span = 0; span < spans; span++)
+				{
+					//All types of neighbouring cells in x direction are one contiguous range
+					const int row = (cellZ[iz] * cells + cellY[iy]) * cells;
+					const int first = a.bucketStart[(row + spanFirst[span]) * types];
+					const int last = a.bucketStart[(row + spanLast[span] + 1) * types];
+
+					for (int k = first; k < last; k += Ops::WIDTH)
+					{
+						const V dx = minimumImage<Ops>(c, Ops::sub(Ops::load(a.x + k), vx), periodic);
+						const V dy = minimumImage<Ops>(c, Ops::sub(Ops::load(a.y + k), vy), periodic);
+						const V dz = minimumImage<Ops>(c, Ops::sub(Ops::load(a.z + k), vz), periodic);
+						accumulateForce<Ops>(c, force, dx, dy, dz, a.type + k, Ops::firstN(last - k), fx, fy, fz);
+					}
+				}
+			}
+		}
+
+		const int p = a.sortedIndex[i];
+		a.forceX[p] = Ops::sum(fx) * a.distanceMax;
+		a.forceY[p] = Ops::sum(fy) * a.distanceMax;
+		a.forceZ[p] = Ops::sum(fz) * a.distanceMax;
+	}
+	Ops::finish();
+}
+
+//Neighbours from the Verlet lists, gathered loads but only candidates within distanceMax + skin
+template <class Ops, class Boundary, class Force>
+static void computeForcesListImpl(const ForceKernelArgs& a, int begin, int end)
+{
+	typedef typename Ops::V V;
+
+	const KernelConstants<Ops> c(a.distanceMax, a.period);
+	Force force(a);
+	const bool periodic = Boundary::periodic(a);
+
+	for (int i = begin; i < end; i++)
+	{
+		const V vx = Ops::set1(a.x[i]);
+		const V vy = Ops::set1(a.y[i]);
+		const V vz = Ops::set1(a.z[i]);
+		force.setParticle(a.type[i]);
+
+		V fx = c.zero;
+		V fy = c.zero;
+		V fz = c.zero;
+
+		const int first = a.neighbourStart[i];
+		const int last = a.neighbourStart[i + 1];
+		for (int k = first; k < last; k += Ops::WIDTH)
+		{
+			const int* index = a.neighbours + k;
+			const V dx = minimumImage<Ops>(c, Ops::sub(Ops::gather(a.x, index), vx), periodic);
+			const V dy = minimumImage<Ops>(c, Ops::sub(Ops::gather(a.y, index), vy), periodic);
+			const V dz = minimumImage<Ops>(c, Ops::sub(Ops::gather(a.z, index), vz), periodic);
+			accumulateForce<Ops>(c, force, dx, dy, dz, a.neighbourTypes + k, Ops::firstN(last - k), fx, fy, fz);
+		}
+
+		const int p = a.sortedIndex[i];
+		a.forceX[p] = Ops::sum(fx) * a.distanceMax;
+		a.forceY[p] = Ops::sum(fy) * a.distanceMax;
+		a.forceZ[p] = Ops::sum(fz) * a.distanceMax;
+	}
+	Ops::finish();
+}
+
+//One contiguous range of neighbours for the pair kernels: forces on particle i are summed in (fx, fy, fz), the neighbours get theirs right away
+template <class Ops, class Boundary, class Force>
+static inline void accumulatePairRange(const ForceKernelArgs& a, const KernelConstants<Ops>& c, const Force& force, typename Ops::V vx, typename Ops::V vy, typename Ops::V vz,
+	int first, int last, typename Ops::V& fx, typename Ops::V& fy, typename Ops::V& fz, float* accX, float* accY, float* accZ)
+{
+	typedef typename Ops::V V;
+	const bool periodic = Boundary::periodic(a);
+
+	for (int k = first; k < last; k += Ops::WIDTH)
+	{
+		const V dx = minimumImage<Ops>(c, Ops::sub(Ops::load(a.x + k), vx), periodic);
+		const V dy = minimumImage<Ops>(c, Ops::sub(Ops::load(a.y + k), vy), periodic);
+		const V dz = minimumImage<Ops>(c, Ops::sub(Ops::load(a.z + k), vz), periodic);
+		const V d2 = Ops::add(Ops::add(Ops::mul(dx, dx), Ops::mul(dy, dy)), Ops::mul(dz, dz));
+
+		V si;
+		V sn;
+		force.scalePair(PairDistance<Ops>(c, d2, Ops::firstN(last - k)), a.type + k, si, sn);
+
+		fx = Ops::add(fx, Ops::mul(si, dx));
+		fy = Ops::add(fy, Ops::mul(si, dy));
+		fz = Ops::add(fz, Ops::mul(si, dz));
+
+		//Lanes past last add 0, the accumulators are padded and only touched by this worker
+		Ops::store(accX + k, Ops::sub(Ops::load(accX + k), Ops::mul(sn, dx)));
+		Ops::store(accY + k, Ops::sub(Ops::load(accY + k), Ops::mul(sn, dy)));
+		Ops::store(accZ + k, Ops::sub(Ops::load(accZ + k), Ops::mul(sn, dz)));
+	}
+}
+
+//Next cell on one axis, -1 at the border of a non periodic box
+static inline int forwardCell(int c, int cells, bool periodic)
+{
+	if (c < cells - 1)
+	{
+		return c + 1;
+	}
+	return periodic ? 0 : -1;
+}
+
+//Half shell: every pair of particles once, from the particle that comes first in grid order.
+//Forward neighbours are the rest of the own cell, the next cell in x and the 13 cells after it in (z, y, x) order, 5 contiguous rows in total.
+//Periodic boxes need at least 3 cells per axis, otherwise a cell would be its own forward and backward neighbour.
+template <class Ops, class Boundary, class Force>
+static void computePairForcesCellsImpl(const ForceKernelArgs& a, int begin, int end, float* accX, float* accY, float* accZ)
+{
+	typedef typename Ops::V V;
+
+	const KernelConstants<Ops> c(a.distanceMax, a.period);
+	Force force(a);
+	const bool periodic = Boundary::periodic(a);
+	const int cells = a.cellsPerAxis;
+	const int types = Force::TYPES > 0 ? Force::TYPES : a.typeCount;
+
+	for (int i = begin; i < end; i++)
+	{
+		const float px = a.x[i];
+		const float py = a.y[i];
+		const float pz = a.z[i];
+		const V vx = Ops::set1(px);
+		const V vy = Ops::set1(py);
+		const V vz = Ops::set1(pz);
+		force.setParticle(a.type[i]);
+
+		V fx = c.zero;
+		V fy = c.zero;
+		V fz = c.zero;
+
+		const int cx = kernelCellCoord(a, px);
+		const int cy = kernelCellCoord(a, py);
+		const int cz = kernelCellCoord(a, pz);
+		int spanFirst[2];
+		int spanLast[2];
+		const int spans = neighbourSpans(cx, cells, periodic, spanFirst, spanLast);
+
+		//Own row: particles after i up to the end of the next cell in x
+		const int ownRow = (cz * cells + cy) * cells;
+		const int nextX = forwardCell(cx, cells, periodic);
+		if (nextX > cx)
+		{
+			accumulatePairRange<Ops, Boundary, Force>(a, c, force, vx, vy, vz, i + 1, a.bucketStart[(ownRow + nextX + 1) * types], fx, fy, fz, accX, accY, accZ);
+		}
+		else
+		{
+			accumulatePairRange<Ops, Boundary, Force>(a, c, force, vx, vy, vz, i + 1, a.bucketStart[(ownRow + cx + 1) * types], fx, fy, fz, accX, accY, accZ);
+			if (nextX == 0)
+			{
+				accumulatePairRange<Ops, Boundary, Force>(a, c, force, vx, vy, vz, a.bucketStart[ownRow * types], a.bucketStart[(ownRow + 1) * types], fx, fy, fz, accX, accY, accZ);
+			}
+		}
+
+		//Rows (y + 1, z) and (y - 1 .. y + 1, z + 1), all three cells in x
+		int rows[4];
+		int rowCount = 0;
+		const int nextY = forwardCell(cy, cells, periodic);
+		if (nextY >= 0)
+		{
+			rows[rowCount++] = (cz * cells + nextY) * cells;
+		}
+		const int nextZ = forwardCell(cz, cells, periodic);
+		if (nextZ >= 0)
+		{
+			int cellY[3];
+			const int countY = neighbourCells(cy, cells, periodic, cellY);
+			for (int iy = 0; iy < countY; iy++)
+			{
+				rows[rowCount++] = (nextZ * cells + cellY[iy]) * cells;
+			}
+		}
+
+		for (int r = 0; r < rowCount; r++)
+		{
+			for (int span = 0; span < spans; span++)
+			{
+				const int first = a.bucketStart[(rows[r] + spanFirst[span]) * types];
+				const int last = a.bucketStart[(rows[r] + spanLast[span] + 1) * types];
+				accumulatePairRange<Ops, Boundary, Force>(a, c, force, vx, vy, vz, first, last, fx, fy, fz, accX, accY, accZ);
+			}
+		}
+
+		accX[i] += Ops::sum(fx);
+		accY[i] += Ops::sum(fy);
+		accZ[i] += Ops::sum(fz);
+	}
+	Ops::finish();
+}
+
+//Dispatch------------------------------------------------------------------------------
+//Boundary, force law and type count are template parameters, every combination gets its own loops without runtime checks.
+//The variant is picked once per step; the generic one reads boundary and type count from the arguments and covers all other cases.
+
+template <class Ops, class Boundary, class Force>
+static ForceKernelFunc selectForceKernelVariant(const ForceKernelArgs& a)
+{
+	if (a.neighbourStart)
+	{
+		return computeForcesListImpl<Ops, Boundary, Force>;
+	}
+	return computeForcesCellsImpl<Ops, Boundary, Force>;
+}
+
+template <class Ops, class Force>
+static ForceKernelFunc selectForceKernelBoundary(const ForceKernelArgs& a, bool generic)
+{
+	if (generic)
+	{
+		return selectForceKernelVariant<Ops, RuntimeBox, Force>(a);
+	}
+	if (a.period > 0.0f)
+	{
+		return selectForceKernelVariant<Ops, PeriodicBox, Force>(a);
+	}
+	return selectForceKernelVariant<Ops, OpenBox, Force>(a);
+}
+
+template <class Ops, class Force>
+static PairKernelFunc selectPairKernelBoundary(const ForceKernelArgs& a, bool generic)
+{
+	if (generic)
+	{
+		return computePairForcesCellsImpl<Ops, RuntimeBox, Force>;
+	}
+	if (a.period > 0.0f)
+	{
+		return computePairForcesCellsImpl<Ops, PeriodicBox, Force>;
+	}
+	return computePairForcesCellsImpl<Ops, OpenBox, Force>;
+}
+
+template <class Ops, int Types>
+static ForceKernelFunc selectForceKernelLaw(const ForceKernelArgs& a, bool generic)
+{
+	switch (a.forceLaw)
+	{
+	case FORCE_TABLE_LINEAR:
+		return selectForceKernelBoundary<Ops, TableForce<Ops, false, Types> >(a, generic);
+	case FORCE_TABLE_CUBIC:
+		return selectForceKernelBoundary<Ops, TableForce<Ops, true, Types> >(a, generic);
+	default:
+		return selectForceKernelBoundary<Ops, FormulaForce<Ops, Types> >(a, generic);
+	}
+}
+
+template <class Ops, int Types>
+static PairKernelFunc selectPairKernelLaw(const ForceKernelArgs& a, bool generic)
+{
+	switch (a.forceLaw)
+	{
+	case FORCE_TABLE_LINEAR:
+		return selectPairKernelBoundary<Ops, TableForce<Ops, false, Types> >(a, generic);
+	case FORCE_TABLE_CUBIC:
+		return selectPairKernelBoundary<Ops, TableForce<Ops, true, Types> >(a, generic);
+	default:
+		return selectPairKernelBoundary<Ops, FormulaForce<Ops, Types> >(a, generic);
+	}
+}
+
+//Type counts 2 to 8 (the usual range) are compiled in, others run with the runtime count
+template <class Ops>
+static ForceKernelFunc selectForceKernelImpl(const ForceKernelArgs& a, bool generic)
+{
+	if (!generic)
+	{
+		switch (a.typeCount)
+		{
+		case 2:
+			return selectForceKernelLaw<Ops, 2>(a, false);
+		case 3:
+			return selectForceKernelLaw<Ops, 3>(a, false);
+		case 4:
+			return selectForceKernelLaw<Ops, 4>(a, false);
+		case 5:
+			return selectForceKernelLaw<Ops, 5>(a, false);
+		case 6:
+			return selectForceKernelLaw<Ops, 6>(a, false);
+		case 7:
+			return selectForceKernelLaw<Ops, 7>(a, false);
+		case 8:
+			return selectForceKernelLaw<Ops, 8>(a, false);
+		default:
+			break;
+		}
+	}
+	return selectForceKernelLaw<Ops, 0>(a, generic);
+}
+
+template <class Ops>
+static PairKernelFunc selectPairKernelImpl(const ForceKernelArgs& a, bool generic)
+{
+	if (!generic)
+	{
+		switch (a.typeCount)
+		{
+		case 2:
+			return selectPairKernelLaw<Ops, 2>(a, false);
+		case 3:
+			return selectPairKernelLaw<Ops, 3>(a, false);
+		case 4:
+			return selectPairKernelLaw<Ops, 4>(a, false);
+		case 5:
+			return selectPairKernelLaw<Ops, 5>(a, false);
+		case 6:
+			return selectPairKernelLaw<Ops, 6>(a, false);
+		case 7:
+			return selectPairKernelLaw<Ops, 7>(a, false);
+		case 8:
+			return selectPairKernelLaw<Ops, 8>(a, false);
+		default:
+			break;
+		}
+	}
+	return selectPairKernelLaw<Ops, 0>(a, generic);
+}
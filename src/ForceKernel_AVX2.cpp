@@ -0,0 +1,107 @@
+#include "ForceKernel.h"
+
+#ifdef LIFE3D_X86
+#include <immintrin.h>
+
+//MSVC: this file is compiled with /arch:AVX2, gcc/clang get the target from the pragma
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx2")
+#endif
+
+//8 lanes, hardware gather for the attraction lookup
+struct Avx2Ops
+{
+	typedef __m256 V;
+	typedef __m256 M;
+	typedef __m256i I;
+	static const int WIDTH = 8;
+
+	static inline V set1(float v) { return _mm256_set1_ps(v); }
+	static inline V load(const float* p) { return _mm256_loadu_ps(p); }
+	static inline void store(float* p, V v) { _mm256_storeu_ps(p, v); }
+	static inline V add(V a, V b) { return _mm256_add_ps(a, b); }
+	static inline V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+	static inline V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+	static inline V abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+
+	static inline M less(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static inline M greater(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static inline M andMask(M a, M b) { return _mm256_and_ps(a, b); }
+	static inline M firstN(int n) { return _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(n), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7))); }
+	static inline V select(M m, V a, V b) { return _mm256_blendv_ps(b, a, m); }
+
+	static inline V rsqrt(V v)
+	{
+		//Approximation plus one Newton-Raphson step
+		V r = _mm256_rsqrt_ps(v);
+		return _mm256_mul_ps(r, _mm256_sub_ps(_mm256_set1_ps(1.5f), _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), v), _mm256_mul_ps(r, r))));
+	}
+
+	static inline V gather(const float* base, const int* index)
+	{
+		return _mm256_i32gather_ps(base, _mm256_loadu_si256((const __m256i*)index), 4);
+	}
+
+	static inline V lookup(const float* row, const int* index, int count)
+	{
+		//Up to 8 types the whole row fits into one register, a permute is much cheaper than a gather
+		if (count <= 8)
+		{
+			return _mm256_permutevar8x32_ps(_mm256_loadu_ps(row), _mm256_loadu_si256((const __m256i*)index));
+		}
+		return gather(row, index);
+	}
+
+	static inline I loadInt(const int* p) { return _mm256_loadu_si256((const __m256i*)p); }
+	static inline I toInt(V v) { return _mm256_cvttps_epi32(v); }
+	static inline V toFloat(I i) { return _mm256_cvtepi32_ps(i); }
+
+	static inline void loadRecords(const float* base, I index, V& c0, V& c1, V& c2, V& c3)
+	{
+		//Records of lanes k and k + 4 share a register, the in-lane transpose then leaves every coefficient in lane order
+		int lanes[8];
+		_mm256_storeu_si256((__m256i*)lanes, index);
+		V r[4];
+		for (int k = 0; k < 4; k++)
+		{
+			r[k] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(base + 4 * lanes[k])), _mm_loadu_ps(base + 4 * lanes[k + 4]), 1);
+		}
+		V t0 = _mm256_unpacklo_ps(r[0], r[1]);
+		V t1 = _mm256_unpackhi_ps(r[0], r[1]);
+		V t2 = _mm256_unpacklo_ps(r[2], r[3]);
+		V t3 = _mm256_unpackhi_ps(r[2], r[3]);
+		c0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		c1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		c2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		c3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+
+	static inline float sum(V v)
+	{
+		__m128 half = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+		__m128 pair = _mm_add_ps(half, _mm_movehl_ps(half, half));
+		return _mm_cvtss_f32(_mm_add_ss(pair, _mm_shuffle_ps(pair, pair, 1)));
+	}
+
+	//Avoid AVX/SSE transition penalties in the code that follows
+	static inline void finish() { _mm256_zeroupper(); }
+};
+
+#include "ForceKernel.inl"
+
+ForceKernelFunc selectForceKernelAVX2(const ForceKernelArgs& args, bool generic)
+{
+	return selectForceKernelImpl<Avx2Ops>(args, generic);
+}
+
+PairKernelFunc selectPairKernelAVX2(const ForceKernelArgs& args, bool generic)
+{
+	return selectPairKernelImpl<Avx2Ops>(args, generic);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+#endif
@@ -0,0 +1,106 @@
+#include "ForceKernel.h"
+
+#ifdef LIFE3D_X86
+#include <immintrin.h>
+
+//MSVC: this file is compiled with /arch:AVX512, gcc/clang get the target from the pragma
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx512f")
+#endif
+
+//16 lanes, compare results are real mask registers
+struct Avx512Ops
+{
+	typedef __m512 V;
+	typedef __mmask16 M;
+	typedef __m512i I;
+	static const int WIDTH = 16;
+
+	static inline V set1(float v) { return _mm512_set1_ps(v); }
+	static inline V load(const float* p) { return _mm512_loadu_ps(p); }
+	static inline void store(float* p, V v) { _mm512_storeu_ps(p, v); }
+	static inline V add(V a, V b) { return _mm512_add_ps(a, b); }
+	static inline V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+	static inline V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+	static inline V abs(V a) { return _mm512_abs_ps(a); }
+
+	static inline M less(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+	static inline M greater(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+	static inline M andMask(M a, M b) { return (M)(a & b); }
+	static inline M firstN(int n) { return n >= 16 ? (M)0xFFFF : (M)((1u << n) - 1); }
+	static inline V select(M m, V a, V b) { return _mm512_mask_blend_ps(m, b, a); }
+
+	static inline V rsqrt(V v)
+	{
+		//14 bit approximation plus one Newton-Raphson step
+		V r = _mm512_rsqrt14_ps(v);
+		return _mm512_mul_ps(r, _mm512_sub_ps(_mm512_set1_ps(1.5f), _mm512_mul_ps(_mm512_mul_ps(_mm512_set1_ps(0.5f), v), _mm512_mul_ps(r, r))));
+	}
+
+	static inline V gather(const float* base, const int* index)
+	{
+		return _mm512_i32gather_ps(_mm512_loadu_si512(index), base, 4);
+	}
+
+	static inline V lookup(const float* row, const int* index, int count)
+	{
+		//Rows of up to 32 types fit into two registers, permutes are much cheaper than a gather
+		const __m512i i = _mm512_loadu_si512(index);
+		if (count <= 16)
+		{
+			return _mm512_permutexvar_ps(i, _mm512_loadu_ps(row));
+		}
+		return _mm512_permutex2var_ps(_mm512_loadu_ps(row), i, _mm512_loadu_ps(row + 16));
+	}
+
+	static inline I loadInt(const int* p) { return _mm512_loadu_si512(p); }
+	static inline I toInt(V v) { return _mm512_cvttps_epi32(v); }
+	static inline V toFloat(I i) { return _mm512_cvtepi32_ps(i); }
+
+	static inline void loadRecords(const float* base, I index, V& c0, V& c1, V& c2, V& c3)
+	{
+		//Records of lanes k, k + 4, k + 8 and k + 12 share a register, the in-lane transpose then leaves every coefficient in lane order
+		int lanes[16];
+		_mm512_storeu_si512(lanes, index);
+		V r[4];
+		for (int k = 0; k < 4; k++)
+		{
+			r[k] = _mm512_castps128_ps512(_mm_loadu_ps(base + 4 * lanes[k]));
+			r[k] = _mm512_insertf32x4(r[k], _mm_loadu_ps(base + 4 * lanes[k + 4]), 1);
+			r[k] = _mm512_insertf32x4(r[k], _mm_loadu_ps(base + 4 * lanes[k + 8]), 2);
+			r[k] = _mm512_insertf32x4(r[k], _mm_loadu_ps(base + 4 * lanes[k + 12]), 3);
+		}
+		V t0 = _mm512_unpacklo_ps(r[0], r[1]);
+		V t1 = _mm512_unpackhi_ps(r[0], r[1]);
+		V t2 = _mm512_unpacklo_ps(r[2], r[3]);
+		V t3 = _mm512_unpackhi_ps(r[2], r[3]);
+		c0 = _mm512_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		c1 = _mm512_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		c2 = _mm512_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		c3 = _mm512_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+
+	static inline float sum(V v) { return _mm512_reduce_add_ps(v); }
+
+	//Avoid AVX/SSE transition penalties in the code that follows
+	static inline void finish() { _mm256_zeroupper(); }
+};
+
+#include "ForceKernel.inl"
+
+ForceKernelFunc selectForceKernelAVX512(const ForceKernelArgs& args, bool generic)
+{
+	return selectForceKernelImpl<Avx512Ops>(args, generic);
+}
+
+PairKernelFunc selectPairKernelAVX512(const ForceKernelArgs& args, bool generic)
+{
+	return selectPairKernelImpl<Avx512Ops>(args, generic);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+#endif
@@ -0,0 +1,79 @@
+#include "ForceKernel.h"
+
+#ifdef LIFE3D_X86
+#include <emmintrin.h>
+
+//4 lanes, baseline of every x64 CPU
+struct SseOps
+{
+	typedef __m128 V;
+	typedef __m128 M;
+	typedef __m128i I;
+	static const int WIDTH = 4;
+
+	static inline V set1(float v) { return _mm_set1_ps(v); }
+	static inline V load(const float* p) { return _mm_loadu_ps(p); }
+	static inline void store(float* p, V v) { _mm_storeu_ps(p, v); }
+	static inline V add(V a, V b) { return _mm_add_ps(a, b); }
+	static inline V sub(V a, V b) { return _mm_sub_ps(a, b); }
+	static inline V mul(V a, V b) { return _mm_mul_ps(a, b); }
+	static inline V abs(V a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+	static inline M less(V a, V b) { return _mm_cmplt_ps(a, b); }
+	static inline M greater(V a, V b) { return _mm_cmpgt_ps(a, b); }
+	static inline M andMask(M a, M b) { return _mm_and_ps(a, b); }
+	static inline M firstN(int n) { return _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_set1_epi32(n), _mm_setr_epi32(0, 1, 2, 3))); }
+	static inline V select(M m, V a, V b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+
+	static inline V rsqrt(V v)
+	{
+		//Approximation plus one Newton-Raphson step
+		V r = _mm_rsqrt_ps(v);
+		return _mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), v), _mm_mul_ps(r, r))));
+	}
+
+	static inline V gather(const float* base, const int* index)
+	{
+		return _mm_setr_ps(base[index[0]], base[index[1]], base[index[2]], base[index[3]]);
+	}
+
+	static inline V lookup(const float* row, const int* index, int count) { return gather(row, index); }
+
+	static inline I loadInt(const int* p) { return _mm_loadu_si128((const __m128i*)p); }
+	static inline I toInt(V v) { return _mm_cvttps_epi32(v); }
+	static inline V toFloat(I i) { return _mm_cvtepi32_ps(i); }
+
+	static inline void loadRecords(const float* base, I index, V& c0, V& c1, V& c2, V& c3)
+	{
+		//One 16 byte load per lane, then transposed into one register per coefficient
+		int lanes[4];
+		_mm_storeu_si128((__m128i*)lanes, index);
+		c0 = _mm_loadu_ps(base + 4 * lanes[0]);
+		c1 = _mm_loadu_ps(base + 4 * lanes[1]);
+		c2 = _mm_loadu_ps(base + 4 * lanes[2]);
+		c3 = _mm_loadu_ps(base + 4 * lanes[3]);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	}
+
+	static inline float sum(V v)
+	{
+		V high = _mm_movehl_ps(v, v);
+		V pair = _mm_add_ps(v, high);
+		return _mm_cvtss_f32(_mm_add_ss(pair, _mm_shuffle_ps(pair, pair, 1)));
+	}
+
+	static inline void finish() {}
+};
+
+#include "ForceKernel.inl"
+
+ForceKernelFunc selectForceKernelSSE(const ForceKernelArgs& args, bool generic)
+{
+	return selectForceKernelImpl<SseOps>(args, generic);
+}
+
+PairKernelFunc selectPairKernelSSE(const ForceKernelArgs& args, bool generic)
+{
+	return selectPairKernelImpl<SseOps>(args, generic);
+}
+#endif
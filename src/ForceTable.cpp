@@ -0,0 +1,163 @@
+#include "ForceTable.h"
+#include <cmath>
+#include <algorithm>
+
+ForceTable::ForceTable()
+{
+	this->builtTypeCount = 0;
+	this->builtBeta = 0.0f;
+	this->builtCubic = false;
+	this->dirty = true;
+}
+
+void ForceTable::update(const float* attraction, int typeCount, float beta, bool cubic)
+{
+	const int pairs = typeCount * typeCount;
+	if (!this->dirty && typeCount == this->builtTypeCount && beta == this->builtBeta && cubic == this->builtCubic
+		&& std::equal(attraction, attraction + pairs, this->builtAttraction.begin()))
+	{
+		return;
+	}
+
+	this->table.assign(pairs * ForceKernelArgs::TABLE_SEGMENTS * 4, 0.0f);
+	this->transposed.assign(pairs * ForceKernelArgs::TABLE_SEGMENTS * 4, 0.0f);
+	for (int i = 0; i < typeCount; i++)
+	{
+		for (int j = 0; j < typeCount; j++)
+		{
+			this->buildPair(i, j, attraction, typeCount, beta, cubic);
+		}
+	}
+
+	if (!cubic)
+	{
+		//Linear records only need two coefficients, the other two carry the opposite direction so the pair kernel loads one record
+		for (int i = 0; i < typeCount; i++)
+		{
+			for (int j = 0; j < typeCount; j++)
+			{
+				for (int s = 0; s < ForceKernelArgs::TABLE_SEGMENTS; s++)
+				{
+					float* record = &this->table[((i * typeCount + j) * ForceKernelArgs::TABLE_SEGMENTS + s) * 4];
+					const float* opposite = &this->transposed[((i * typeCount + j) * ForceKernelArgs::TABLE_SEGMENTS + s) * 4];
+					record[2] = opposite[0];
+					record[3] = opposite[1];
+				}
+			}
+		}
+	}
+
+	this->builtAttraction.assign(attraction, attraction + pairs);
+	this->builtTypeCount = typeCount;
+	this->builtBeta = beta;
+	this->builtCubic = cubic;
+	this->dirty = false;
+}
+
+void ForceTable::setCurve(int type1, int type2, const std::vector<float>& values)
+{
+	if (values.size() < 2)
+	{
+		return;
+	}
+	this->curves[std::make_pair(type1, type2)] = values;
+	this->dirty = true;
+}
+
+void ForceTable::clearCurves()
+{
+	this->curves.clear();
+	this->dirty = true;
+}
+
+int ForceTable::getCurveCount()
+{
+	return (int)this->curves.size();
+}
+
+const float* ForceTable::getTable()
+{
+	return this->table.data();
+}
+
+const float* ForceTable::getTransposed()
+{
+	return this->transposed.data();
+}
+
+float ForceTable::formula(float d, float attraction, float beta)
+{
+	//Force function to prevent particles from collapsing into singularity @Tom Mohr
+	if (d < beta)
+	{
+		return d / beta - 1.0f;
+	}
+	if (d < 1.0f)
+	{
+		return attraction * (1.0f - std::fabs(2.0f * d - 1.0f - beta) / (1.0f - beta));
+	}
+	return 0.0f;
+}
+
+//Helper------------------------------------------------------------------------------
+
+float ForceTable::sample(int type1, int type2, float d, const float* attraction, int typeCount, float beta)
+{
+	std::map<std::pair<int, int>, std::vector<float>>::iterator curve = this->curves.find(std::make_pair(type1, type2));
+	if (curve == this->curves.end())
+	{
+		return formula(d, attraction[type1 * typeCount + type2], beta);
+	}
+
+	//Linear between the given values
+	const std::vector<float>& values = curve->second;
+	float x = std::max(0.0f, std::min(d, 1.0f)) * (values.size() - 1);
+	int i = std::min((int)x, (int)values.size() - 2);
+	float t = x - i;
+	return values[i] + t * (values[i + 1] - values[i]);
+}
+
+void ForceTable::buildPair(int type1, int type2, const float* attraction, int typeCount, float beta, bool cubic)
+{
+	const int segments = ForceKernelArgs::TABLE_SEGMENTS;
+
+	//Samples at the segment borders, one extrapolated on each side for the cubic ends
+	std::vector<float> p(segments + 3);
+	for (int s = 0; s <= segments; s++)
+	{
+		p[s + 1] = this->sample(type1, type2, (float)s / segments, attraction, typeCount, beta);
+	}
+	p[0] = 2.0f * p[1] - p[2];
+	p[segments + 2] = 2.0f * p[segments + 1] - p[segments];
+
+	for (int s = 0; s < segments; s++)
+	{
+		const float p0 = p[s];
+		const float p1 = p[s + 1];
+		const float p2 = p[s + 2];
+		const float p3 = p[s + 3];
+
+		float c[4];
+		if (cubic)
+		{
+			//Catmull-Rom through the samples in Horner form
+			c[0] = p1;
+			c[1] = 0.5f * (p2 - p0);
+			c[2] = p0 - 2.5f * p1 + 2.0f * p2 - 0.5f * p3;
+			c[3] = 0.5f * (p3 - p0) + 1.5f * (p1 - p2);
+		}
+		else
+		{
+			c[0] = p1;
+			c[1] = p2 - p1;
+			c[2] = 0.0f;
+			c[3] = 0.0f;
+		}
+
+		for (int k = 0; k < 4; k++)
+		{
+			this->table[((type1 * typeCount + type2) * segments + s) * 4 + k] = c[k];
+			this->transposed[((type2 * typeCount + type1) * segments + s) * 4 + k] = c[k];
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <map>
+
+#include "ForceKernel.h"
+
+//Force per type pair sampled over the normalized distance d = distance / distanceMax in [0, 1].
+//Every pair gets ForceKernelArgs::TABLE_SEGMENTS polynomial segments, stored as records of 4 coefficients [type][type][segment][coefficient] so the kernel loads a segment at once.
+//Linear segments use coefficients 0 and 1, coefficients 2 and 3 hold the segment of the opposite direction (type2 receiving from type1).
+//Pairs without an own curve use the formula with the current attraction matrix.
+class ForceTable
+{
+public:
+	ForceTable();
+
+	//Rebuilds the tables if the attraction matrix, beta, the interpolation or the curves changed since the last call
+	void update(const float* attraction, int typeCount, float beta, bool cubic);
+
+	//Own force curve of type1 (receiving) from type2: values at equally spaced d, the first at 0 and the last at 1 (at least 2 values).
+	//Replaces formula and attraction factor of the pair.
+	void setCurve(int type1, int type2, const std::vector<float>& values);
+	void clearCurves();
+	int getCurveCount();
+
+	const float* getTable();
+	const float* getTransposed(); //Row = type exerting the force (pair kernel)
+
+	//Same function as FormulaForce in the kernel
+	static float formula(float d, float attraction, float beta);
+
+private:
+	std::vector<float> table;
+	std::vector<float> transposed;
+	std::map<std::pair<int, int>, std::vector<float>> curves;
+
+	//State of the last build
+	std::vector<float> builtAttraction;
+	int builtTypeCount;
+	float builtBeta;
+	bool builtCubic;
+	bool dirty;
+
+	float sample(int type1, int type2, float d, const float* attraction, int typeCount, float beta);
+	void buildPair(int type1, int type2, const float* attraction, int typeCount, float beta, bool cubic);
+};
+
@@ -0,0 +1,549 @@
+#include "SimulationCore.h"
+#include "Snapshot.h"
+#include "TrajectoryRecorder.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ctime>
+#include <cstdlib>
+
+//Batch runner without window or GPU, only the physics of SimulationCore
+
+struct HeadlessOptions
+{
+	int amount;
+	int typeCount;
+	int steps;
+	unsigned int seed;
+	float dt;
+	int threads;
+	bool pin;
+	float distanceMax;
+	float cubeSize;
+	float timeFactor;
+	BoundaryMode boundary;
+	ForceLaw forceLaw;
+	float beta;
+	bool neighbourLists;
+	bool halfShell;
+	bool generic;
+	float skin;
+	int reorderInterval;
+	std::string attraction;
+	std::string attractionFile;
+	std::string forceFile;
+	std::string output;
+	int outputEvery;
+	std::string load;
+	std::string save;
+	int checkpointEvery;
+	std::string checkpointFile;
+	std::string record;
+	int recordEvery;
+	int keyframeEvery;
+	int recordBits;
+};
+
+static void printUsage(const char* name)
+{
+	std::cerr << "Usage: " << name << " [options]\n"
+		<< "  --amount N            particles per type (default 1000)\n"
+		<< "  --types N             number of types (default 5, max " << SimulationCore::MAX_TYPES << ")\n"
+		<< "  --steps N             steps to simulate (default 1000)\n"
+		<< "  --seed N              random seed (default: time)\n"
+		<< "  --dt F                time per step in seconds (default 0.016)\n"
+		<< "  --threads N           worker threads, 0 = all hardware threads (default 0)\n"
+		<< "  --pin                 pin worker threads to cores\n"
+		<< "  --attraction LIST     types*types comma separated values, row = type receiving the force\n"
+		<< "  --attraction-file F   same as --attraction, values read from a file\n"
+		<< "  --distance F          interaction distance (default 150)\n"
+		<< "  --box F               half edge length of the border box (default 250)\n"
+		<< "  --timefactor F        time factor (default 0.7)\n"
+		<< "  --boundary MODE       reflective, periodic or none (default reflective)\n"
+		<< "  --no-borders          same as --boundary none\n"
+		<< "  --force LAW           formula, linear or cubic (tables sampled per type pair, default formula)\n"
+		<< "  --beta F              end of the repulsion as fraction of the distance (default 0.3)\n"
+		<< "  --force-file F        own force curves, one line per pair: type1 type2 values over [0, distance] (* = all types)\n"
+		<< "  --skin F              neighbour list skin (default 15)\n"
+		<< "  --no-lists            search the grid cells every step instead of using neighbour lists\n"
+		<< "  --full-shell          cell search visits every pair from both particles instead of once\n"
+		<< "  --generic             kernels and integration with runtime checks instead of the compiled variants\n"
+		<< "  --reorder N           Morton reorder of the particle arrays every N steps, 0 = never (default 100)\n"
+		<< "  --output F            write the particle state as CSV\n"
+		<< "  --output-every N      write every N steps instead of only the final state\n"
+		<< "  --load F              continue from a snapshot (particles, matrix and settings of the file replace the options)\n"
+		<< "  --save F              write a snapshot of the final state\n"
+		<< "  --checkpoint N        write a snapshot every N steps (0 = never, default)\n"
+		<< "  --checkpoint-file F   file for the checkpoints (default checkpoint.l3ds)\n"
+		<< "  --record F            stream the trajectory (quantized, delta coded positions) into a file\n"
+		<< "  --record-every N      record every N steps (default 1)\n"
+		<< "  --keyframe-every N    recorded frames between two keyframes / seek points (default 60)\n"
+		<< "  --record-bits N       quantization of the box edge in bits, 4 - 24 (default 16)\n";
+}
+
+static bool parseValues(const std::string& text, std::vector<float>& values)
+{
+	//Accepts commas, whitespace and newlines as separators
+	std::string cleaned = text;
+	for (char& c : cleaned)
+	{
+		if (c == ',' || c == ';')
+		{
+			c = ' ';
+		}
+	}
+	std::istringstream stream(cleaned);
+	std::string token;
+	while (stream >> token)
+	{
+		char* end = NULL;
+		float value = strtof(token.c_str(), &end);
+		if (end == token.c_str() || *end != '\0')
+		{
+			return false;
+		}
+		values.push_back(value);
+	}
+	return true;
+}
+
+static bool parseArgs(int argc, char** argv, HeadlessOptions& o)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--help" || arg == "-h")
+		{
+			return false;
+		}
+		else if (arg == "--pin")
+		{
+			o.pin = true;
+		}
+		else if (arg == "--no-borders")
+		{
+			o.boundary = BOUNDARY_NONE;
+		}
+		else if (arg == "--no-lists")
+		{
+			o.neighbourLists = false;
+		}
+		else if (arg == "--full-shell")
+		{
+			o.halfShell = false;
+		}
+		else if (arg == "--generic")
+		{
+			o.generic = true;
+		}
+		else if (!hasValue)
+		{
+			std::cerr << "Missing value for " << arg << std::endl;
+			return false;
+		}
+		else if (arg == "--amount")
+		{
+			o.amount = atoi(argv[++i]);
+		}
+		else if (arg == "--types")
+		{
+			o.typeCount = atoi(argv[++i]);
+		}
+		else if (arg == "--steps")
+		{
+			o.steps = atoi(argv[++i]);
+		}
+		else if (arg == "--seed")
+		{
+			o.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		}
+		else if (arg == "--dt")
+		{
+			o.dt = (float)atof(argv[++i]);
+		}
+		else if (arg == "--threads")
+		{
+			o.threads = atoi(argv[++i]);
+		}
+		else if (arg == "--attraction")
+		{
+			o.attraction = argv[++i];
+		}
+		else if (arg == "--attraction-file")
+		{
+			o.attractionFile = argv[++i];
+		}
+		else if (arg == "--distance")
+		{
+			o.distanceMax = (float)atof(argv[++i]);
+		}
+		else if (arg == "--box")
+		{
+			o.cubeSize = (float)atof(argv[++i]);
+		}
+		else if (arg == "--timefactor")
+		{
+			o.timeFactor = (float)atof(argv[++i]);
+		}
+		else if (arg == "--boundary")
+		{
+			std::string mode = argv[++i];
+			if (mode == "reflective")
+			{
+				o.boundary = BOUNDARY_REFLECTIVE;
+			}
+			else if (mode == "periodic")
+			{
+				o.boundary = BOUNDARY_PERIODIC;
+			}
+			else if (mode == "none")
+			{
+				o.boundary = BOUNDARY_NONE;
+			}
+			else
+			{
+				std::cerr << "Unknown boundary " << mode << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--force")
+		{
+			std::string law = argv[++i];
+			if (law == "formula")
+			{
+				o.forceLaw = FORCE_FORMULA;
+			}
+			else if (law == "linear")
+			{
+				o.forceLaw = FORCE_TABLE_LINEAR;
+			}
+			else if (law == "cubic")
+			{
+				o.forceLaw = FORCE_TABLE_CUBIC;
+			}
+			else
+			{
+				std::cerr << "Unknown force law " << law << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--beta")
+		{
+			o.beta = (float)atof(argv[++i]);
+		}
+		else if (arg == "--force-file")
+		{
+			o.forceFile = argv[++i];
+		}
+		else if (arg == "--skin")
+		{
+			o.skin = (float)atof(argv[++i]);
+		}
+		else if (arg == "--reorder")
+		{
+			o.reorderInterval = atoi(argv[++i]);
+		}
+		else if (arg == "--output")
+		{
+			o.output = argv[++i];
+		}
+		else if (arg == "--output-every")
+		{
+			o.outputEvery = atoi(argv[++i]);
+		}
+		else if (arg == "--load")
+		{
+			o.load = argv[++i];
+		}
+		else if (arg == "--save")
+		{
+			o.save = argv[++i];
+		}
+		else if (arg == "--checkpoint")
+		{
+			o.checkpointEvery = atoi(argv[++i]);
+		}
+		else if (arg == "--checkpoint-file")
+		{
+			o.checkpointFile = argv[++i];
+		}
+		else if (arg == "--record")
+		{
+			o.record = argv[++i];
+		}
+		else if (arg == "--record-every")
+		{
+			o.recordEvery = atoi(argv[++i]);
+		}
+		else if (arg == "--keyframe-every")
+		{
+			o.keyframeEvery = atoi(argv[++i]);
+		}
+		else if (arg == "--record-bits")
+		{
+			o.recordBits = atoi(argv[++i]);
+		}
+		else
+		{
+			std::cerr << "Unknown option " << arg << std::endl;
+			return false;
+		}
+	}
+
+	if (o.amount <= 0 || o.typeCount < 1 || o.typeCount > SimulationCore::MAX_TYPES || o.steps < 0 || o.dt <= 0.0f
+		|| o.threads < 0 || o.distanceMax <= 0.0f || o.cubeSize <= 0.0f || o.beta <= 0.0f || o.beta >= 1.0f || o.skin < 0.0f || o.reorderInterval < 0 || o.outputEvery < 0 || o.checkpointEvery < 0
+		|| o.recordEvery < 1 || o.keyframeEvery < 1 || o.recordBits < 4 || o.recordBits > 24)
+	{
+		std::cerr << "Invalid option value" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static bool loadForceCurves(const std::string& fileName, SimulationCore& core)
+{
+	//type1 type2 v0 v1 ... vn, # starts a comment, * stands for every type
+	std::ifstream file(fileName);
+	if (!file)
+	{
+		std::cerr << "Could not open " << fileName << std::endl;
+		return false;
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+		std::istringstream stream(line);
+		std::string type1;
+		std::string type2;
+		if (!(stream >> type1))
+		{
+			continue;
+		}
+		std::string rest;
+		std::getline(stream >> type2, rest);
+
+		std::vector<float> values;
+		if (type2.empty() || !parseValues(rest, values) || values.size() < 2)
+		{
+			std::cerr << fileName << ":" << lineNumber << ": expected type1 type2 and at least 2 values" << std::endl;
+			return false;
+		}
+
+		const int types = core.getTypeCount();
+		for (int i = 0; i < types; i++)
+		{
+			for (int j = 0; j < types; j++)
+			{
+				if ((type1 == "*" || atoi(type1.c_str()) == i) && (type2 == "*" || atoi(type2.c_str()) == j))
+				{
+					core.setForceCurve(i, j, values);
+				}
+			}
+		}
+	}
+	return true;
+}
+
+static void writeState(std::ofstream& file, SimulationCore& core, int step)
+{
+	//Rows in id order, independent of reorders
+	Life3D_Particles& p = core.getParticles();
+	std::vector<int> index(p.size());
+	for (int i = 0; i < p.size(); i++)
+	{
+		index[p.id[i]] = i;
+	}
+	for (int i : index)
+	{
+		file << step << ',' << p.posX[i] << ',' << p.posY[i] << ',' << p.posZ[i] << ','
+			<< p.velX[i] << ',' << p.velY[i] << ',' << p.velZ[i] << ',' << p.type[i] << '\n';
+	}
+}
+
+int main(int argc, char** argv)
+{
+	HeadlessOptions o;
+	o.amount = 1000;
+	o.typeCount = 5;
+	o.steps = 1000;
+	o.seed = (unsigned int)time(0);
+	o.dt = 0.016f;
+	o.threads = 0;
+	o.pin = false;
+	o.distanceMax = 150.0f;
+	o.cubeSize = 250.0f;
+	o.timeFactor = 0.7f;
+	o.boundary = BOUNDARY_REFLECTIVE;
+	o.forceLaw = FORCE_FORMULA;
+	o.beta = 0.3f;
+	o.neighbourLists = true;
+	o.halfShell = true;
+	o.generic = false;
+	o.skin = 15.0f;
+	o.reorderInterval = 100;
+	o.outputEvery = 0;
+	o.checkpointEvery = 0;
+	o.checkpointFile = "checkpoint.l3ds";
+	o.recordEvery = 1;
+	o.keyframeEvery = 60;
+	o.recordBits = 16;
+
+	if (!parseArgs(argc, argv, o))
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	//Attraction matrix from the command line or a file, random otherwise
+	std::vector<float> attraction;
+	std::string attractionText = o.attraction;
+	if (!o.attractionFile.empty())
+	{
+		std::ifstream file(o.attractionFile);
+		if (!file)
+		{
+			std::cerr << "Could not open " << o.attractionFile << std::endl;
+			return 1;
+		}
+		std::stringstream content;
+		content << file.rdbuf();
+		attractionText = content.str();
+	}
+	if (!attractionText.empty())
+	{
+		if (!parseValues(attractionText, attraction) || (int)attraction.size() != o.typeCount * o.typeCount)
+		{
+			std::cerr << "Attraction matrix needs " << o.typeCount * o.typeCount << " values" << std::endl;
+			return 1;
+		}
+	}
+
+	srand(o.seed);
+	SimulationCore core(o.amount, o.typeCount, o.threads, o.pin);
+	core.settings.distanceMax = o.distanceMax;
+	core.settings.cubeSize = o.cubeSize;
+	core.settings.timeFactor = o.timeFactor;
+	core.settings.boundary = o.boundary;
+	core.settings.forceLaw = o.forceLaw;
+	core.settings.beta = o.beta;
+	core.settings.neighbourLists = o.neighbourLists;
+	core.settings.halfShell = o.halfShell;
+	core.settings.specializedKernels = !o.generic;
+	core.settings.skin = o.skin;
+	core.settings.reorderInterval = o.reorderInterval;
+	if (o.cubeSize != 250.0f)
+	{
+		//Initial positions should fill the requested box
+		core.randomPosition();
+	}
+	for (int i = 0; i < (int)attraction.size(); i++)
+	{
+		core.setAttraction(i / o.typeCount, i % o.typeCount, attraction[i]);
+	}
+
+	if (!o.load.empty())
+	{
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		if (!Snapshot::load(o.load, core, NULL))
+		{
+			return 1;
+		}
+		std::cout << "Loaded " << o.load << " (step " << core.getStepCount() << ") in "
+			<< std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() * 1000.0 << " ms" << std::endl;
+	}
+
+	if (!o.forceFile.empty())
+	{
+		if (!loadForceCurves(o.forceFile, core))
+		{
+			return 1;
+		}
+		if (core.settings.forceLaw == FORCE_FORMULA)
+		{
+			//Curves only exist as tables
+			core.settings.forceLaw = FORCE_TABLE_LINEAR;
+		}
+	}
+
+	std::ofstream output;
+	if (!o.output.empty())
+	{
+		output.open(o.output);
+		if (!output)
+		{
+			std::cerr << "Could not open " << o.output << std::endl;
+			return 1;
+		}
+		output << "step,x,y,z,vx,vy,vz,type\n";
+	}
+
+	//Frames are coded and written on the thread of the recorder, capture only quantizes
+	TrajectoryRecorder recorder;
+	if (!o.record.empty())
+	{
+		if (!recorder.open(o.record, core, o.keyframeEvery, o.recordBits))
+		{
+			return 1;
+		}
+		recorder.capture(core);
+	}
+
+	std::cout << "Particles: " << core.getParticles().size() << " (" << core.getTypeCount() << " Types), Steps: " << o.steps
+		<< ", Seed: " << o.seed << ", Boundary: " << getBoundaryName(core.settings.boundary) << ", Force: " << getForceLawName(core.settings.forceLaw) << ", SIMD: " << getSimdName(core.getSimdLevel())
+		<< ", Kernels: " << (o.generic ? "generic" : "specialized") << ", Threads: " << core.getThreadPool()->getThreadCount() << std::endl;
+
+	//Output writing is not part of the measured time, steps continue the count of a loaded snapshot
+	const int firstStep = core.getStepCount();
+	double simulated = 0.0;
+	for (int step = 1; step <= o.steps; step++)
+	{
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		core.step(o.dt);
+		simulated += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+		if (output.is_open() && o.outputEvery > 0 && step % o.outputEvery == 0)
+		{
+			writeState(output, core, firstStep + step);
+		}
+		if (recorder.isOpen() && step % o.recordEvery == 0)
+		{
+			recorder.capture(core);
+		}
+		if (o.checkpointEvery > 0 && core.getStepCount() % o.checkpointEvery == 0 && !Snapshot::save(o.checkpointFile, core, NULL))
+		{
+			return 1;
+		}
+	}
+	if (output.is_open() && (o.outputEvery == 0 || o.steps % o.outputEvery != 0))
+	{
+		writeState(output, core, firstStep + o.steps);
+	}
+	if (!o.save.empty() && !Snapshot::save(o.save, core, NULL))
+	{
+		return 1;
+	}
+
+	if (recorder.isOpen())
+	{
+		recorder.close();
+		RecorderStats recorded = recorder.getStats();
+		std::cout << "Recorded: " << recorded.frames << " frames (" << recorded.dropped << " dropped), " << recorded.writtenBytes / 1048576.0
+			<< " MB, compression " << recorded.ratio << ":1, " << recorded.bytesPerSecond / 1048576.0 << " MB/s" << std::endl;
+	}
+
+	NeighbourListStats stats = core.getNeighbourStats();
+	std::cout << "Neighbour lists: " << (stats.active ? "on" : "off") << ", Rebuilds: " << stats.rebuilds << " (every " << stats.rebuildInterval
+		<< " steps), Average length: " << stats.averageLength << std::endl;
+	std::cout << "Time: " << simulated << " s, Steps/s: " << (simulated > 0.0 ? o.steps / simulated : 0.0) << std::endl;
+	return 0;
+}
@@ -0,0 +1,215 @@
+#include "InstanceCuller.h"
+#include <algorithm>
+
+InstanceCuller::InstanceCuller()
+{
+	this->cellsPerAxis = 0;
+	this->visibleCells = 0;
+	this->blocks = 0;
+	this->blockSize = 0;
+	this->count = 0;
+	for (int l = 0; l < LOD_LEVELS; l++)
+	{
+		this->first[l] = 0;
+		this->levelCount[l] = 0;
+	}
+}
+
+int InstanceCuller::classify(const InstanceSource& source, const CullView& view, float cellSize, ThreadPool* threadPool)
+{
+	const int count = source.count;
+	const float cubeSize = source.cubeSize;
+	this->count = count;
+	this->level.resize(count);
+	if (view.frustum)
+	{
+		this->classifyCells(view, cubeSize, cellSize, threadPool);
+	}
+	else
+	{
+		this->cellsPerAxis = 0;
+		this->visibleCells = 0;
+	}
+
+	//Distances compared squared (infinite stays infinite)
+	float lodDistanceSq[LOD_LEVELS - 1];
+	for (int l = 0; l < LOD_LEVELS - 1; l++)
+	{
+		lodDistanceSq[l] = view.lodDistance[l] * view.lodDistance[l];
+	}
+
+	//Fixed blocks, so the scatter offsets of every block are known before compacting
+	this->blocks = std::max(1, std::min(threadPool->getThreadCount() * 4, count / 1024));
+	this->blockSize = (count + this->blocks - 1) / this->blocks;
+	this->histogram.assign(this->blocks * LOD_LEVELS, 0);
+
+	const int cells = this->cellsPerAxis;
+	const float invCellSize = cells / (2.0f * cubeSize);
+	threadPool->parallelFor(0, this->blocks, 1, [&](int blockBegin, int blockEnd, int worker) {
+		for (int block = blockBegin; block < blockEnd; block++)
+		{
+			int* levels = &this->histogram[block * LOD_LEVELS];
+			for (int i = block * this->blockSize; i < std::min(count, (block + 1) * this->blockSize); i++)
+			{
+				const glm::vec3 position = source.position(i);
+				const glm::vec3 center = position + view.center;
+				if (view.frustum)
+				{
+					//Particles outside of the box have no cell and are tested one by one
+					const glm::vec3 cell = (position + cubeSize) * invCellSize;
+					int state = CELL_PARTIAL;
+					if (glm::all(glm::greaterThanEqual(cell, glm::vec3(0.0f))) && glm::all(glm::lessThan(cell, glm::vec3((float)cells))))
+					{
+						state = this->cellState[((int)cell.z * cells + (int)cell.y) * cells + (int)cell.x];
+					}
+					bool visible = state != CELL_OUTSIDE;
+					for (int p = 0; p < 6 && visible && state == CELL_PARTIAL; p++)
+					{
+						visible = glm::dot(glm::vec3(this->planes[p]), center) + this->planes[p].w >= -view.radius;
+					}
+					if (!visible)
+					{
+						this->level[i] = LOD_LEVELS;
+						continue;
+					}
+				}
+
+				const glm::vec3 toCamera = center - view.cameraPos;
+				const float distanceSq = glm::dot(toCamera, toCamera);
+				int l = 0;
+				while (l < LOD_LEVELS - 1 && distanceSq > lodDistanceSq[l])
+				{
+					l++;
+				}
+				this->level[i] = (unsigned char)l;
+				levels[l]++;
+			}
+		}
+	});
+
+	//Exclusive prefix sum level major, block minor: the levels follow each other, the instances keep their order within a level
+	int offset = 0;
+	for (int l = 0; l < LOD_LEVELS; l++)
+	{
+		this->first[l] = offset;
+		for (int block = 0; block < this->blocks; block++)
+		{
+			int levelCount = this->histogram[block * LOD_LEVELS + l];
+			this->histogram[block * LOD_LEVELS + l] = offset;
+			offset += levelCount;
+		}
+		this->levelCount[l] = offset - this->first[l];
+	}
+	return offset;
+}
+
+void InstanceCuller::compact(const InstanceSource& source, ParticleInstance* out, ThreadPool* threadPool)
+{
+	const int count = this->count;
+	threadPool->parallelFor(0, this->blocks, 1, [&](int blockBegin, int blockEnd, int worker) {
+		for (int block = blockBegin; block < blockEnd; block++)
+		{
+			int* fill = &this->histogram[block * LOD_LEVELS];
+			for (int i = block * this->blockSize; i < std::min(count, (block + 1) * this->blockSize); i++)
+			{
+				const int l = this->level[i];
+				if (l < LOD_LEVELS)
+				{
+					//Interpolated again instead of kept from classify, so there is no staging copy of all particles
+					ParticleInstance& instance = out[fill[l]++];
+					instance.position = source.position(i);
+					instance.color = source.colors[i];
+				}
+			}
+		}
+	});
+}
+
+int InstanceCuller::getFirst(int level)
+{
+	return this->first[level];
+}
+
+int InstanceCuller::getCount(int level)
+{
+	return this->levelCount[level];
+}
+
+int InstanceCuller::getCulled()
+{
+	return this->count - this->first[LOD_LEVELS - 1] - this->levelCount[LOD_LEVELS - 1];
+}
+
+int InstanceCuller::getCells()
+{
+	return this->cellsPerAxis * this->cellsPerAxis * this->cellsPerAxis;
+}
+
+int InstanceCuller::getVisibleCells()
+{
+	return this->visibleCells;
+}
+
+void InstanceCuller::extractPlanes(const glm::mat4& viewProjection)
+{
+	//Rows of the matrix (glm is column major): left, right, bottom, top, near, far
+	const glm::mat4 rows = glm::transpose(viewProjection);
+	this->planes[0] = rows[3] + rows[0];
+	this->planes[1] = rows[3] - rows[0];
+	this->planes[2] = rows[3] + rows[1];
+	this->planes[3] = rows[3] - rows[1];
+	this->planes[4] = rows[3] + rows[2];
+	this->planes[5] = rows[3] - rows[2];
+	for (int p = 0; p < 6; p++)
+	{
+		this->planes[p] /= glm::length(glm::vec3(this->planes[p]));
+	}
+}
+
+void InstanceCuller::classifyCells(const CullView& view, float cubeSize, float cellSize, ThreadPool* threadPool)
+{
+	this->extractPlanes(view.viewProjection);
+
+	//Cell edge of the neighbour grid, fewer cells if the interaction distance is small
+	const float boxSize = 2.0f * cubeSize;
+	const int cells = cellSize > 0.0f ? (int)(boxSize / cellSize) : MAX_CELLS_PER_AXIS;
+	this->cellsPerAxis = std::max(1, std::min(cells, (int)MAX_CELLS_PER_AXIS));
+	const int n = this->cellsPerAxis;
+	const float edge = boxSize / n;
+	this->cellState.resize(n * n * n);
+
+	//Box of the bounding sphere centers of the particles in a cell, against every plane: all spheres outside of one plane culls the cell,
+	//some spheres outside of one plane leaves the test to the particles
+	const glm::vec3 halfExtent = glm::vec3(edge * 0.5f);
+	std::vector<int> visible(threadPool->getThreadCount(), 0);
+	threadPool->parallelFor(0, n * n, 16, [&](int begin, int end, int worker) {
+		for (int yz = begin; yz < end; yz++)
+		{
+			for (int x = 0; x < n; x++)
+			{
+				const glm::vec3 center = glm::vec3(x + 0.5f, yz % n + 0.5f, yz / n + 0.5f) * edge - cubeSize + view.center;
+				int state = CELL_INSIDE;
+				for (int p = 0; p < 6 && state != CELL_OUTSIDE; p++)
+				{
+					const float distance = glm::dot(glm::vec3(this->planes[p]), center) + this->planes[p].w;
+					const float extent = glm::dot(glm::abs(glm::vec3(this->planes[p])), halfExtent);
+					if (distance + extent < -view.radius)
+					{
+						state = CELL_OUTSIDE;
+					}
+					else if (distance - extent < -view.radius)
+					{
+						state = CELL_PARTIAL;
+					}
+				}
+				this->cellState[yz * n + x] = (unsigned char)state;
+				visible[worker] += state != CELL_OUTSIDE;
+			}
+		}
+	});
+	this->visibleCells = 0;
+	for (int count : visible)
+	{
+		this->visibleCells += count;
+	}
+}
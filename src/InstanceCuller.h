@@ -0,0 +1,107 @@
+#pragma once
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Life3D_Particles.h"
+#include "ThreadPool.h"
+
+//Levels of detail, the visible instances are compacted level by level in this order
+enum LodLevel
+{
+	LOD_SPHERE,   //Sphere mesh
+	LOD_LOW_POLY, //lp_sphere mesh
+	LOD_IMPOSTOR, //Ray-cast quad
+	LOD_LEVELS
+};
+
+//Camera and particle bounds of one frame
+struct CullView
+{
+	glm::mat4 viewProjection;
+	glm::vec3 cameraPos;
+	glm::vec3 center;   //Bounding sphere of a particle relative to its position
+	float radius;
+	bool frustum;       //Drop the particles outside of the view frustum
+	float lodDistance[LOD_LEVELS - 1]; //Particles farther from the camera than lodDistance[l] get a coarser level than l
+};
+
+//Positions of the particles in id order as the simulation thread or the player hands them over, read in place by the culler.
+//With previous the instances lie between the two frames, particles wrapped around a periodic border jump instead of crossing the box.
+struct InstanceSource
+{
+	const float* current;
+	const float* previous;      //NULL = current only
+	int stride;                 //Floats per position (vec4 frames, vec3 replay)
+	float alpha;                //Between previous and current
+	float cubeSize;
+	const unsigned int* colors; //Packed colors (type or RGB8)
+	int count;
+
+	glm::vec3 position(int i) const
+	{
+		const float* p = this->current + (size_t)i * this->stride;
+		glm::vec3 position = glm::vec3(p[0], p[1], p[2]);
+		if (this->previous != NULL && this->alpha < 1.0f)
+		{
+			const float* q = this->previous + (size_t)i * this->stride;
+			const glm::vec3 from = glm::vec3(q[0], q[1], q[2]);
+			if (glm::all(glm::lessThan(glm::abs(position - from), glm::vec3(this->cubeSize))))
+			{
+				position = glm::mix(from, position, this->alpha);
+			}
+		}
+		return position;
+	}
+};
+
+//Frustum culling and level of detail of the instances before the upload. The border box is split into cells of the size of the neighbour
+//grid (at most MAX_CELLS_PER_AXIS per axis), every cell is tested against the frustum once: particles of cells fully inside or outside
+//need no test of their own, only cells crossing a plane (and particles outside of the box) are tested one by one. Classification and
+//compaction run in fixed blocks on the thread pool, like the radix sort of MortonOrder.
+class InstanceCuller
+{
+public:
+	InstanceCuller();
+
+	//Level of every particle, returns the number of visible ones
+	int classify(const InstanceSource& source, const CullView& view, float cellSize, ThreadPool* threadPool);
+	//Builds the visible instances of the last classify straight into out (mapped GPU memory), level by level in the order of the particles
+	void compact(const InstanceSource& source, ParticleInstance* out, ThreadPool* threadPool);
+
+	//Range of a level in out
+	int getFirst(int level);
+	int getCount(int level);
+	int getCulled();
+	int getCells();
+	int getVisibleCells(); //Not fully outside of the frustum
+
+	static const int MAX_CELLS_PER_AXIS = 32;
+
+private:
+	enum CellState
+	{
+		CELL_OUTSIDE,
+		CELL_INSIDE,
+		CELL_PARTIAL
+	};
+
+	glm::vec4 planes[6]; //Normalized, inside: dot(xyz, p) + w >= 0
+	std::vector<unsigned char> cellState;
+	int cellsPerAxis;
+	int visibleCells;
+
+	std::vector<unsigned char> level; //Per instance, LOD_LEVELS = culled
+
+	//Level counts per block, turned into scatter offsets
+	std::vector<int> histogram;
+	int blocks;
+	int blockSize;
+	int count;
+
+	int first[LOD_LEVELS];
+	int levelCount[LOD_LEVELS];
+
+	void extractPlanes(const glm::mat4& viewProjection);
+	void classifyCells(const CullView& view, float cubeSize, float cellSize, ThreadPool* threadPool);
+};
@@ -0,0 +1,229 @@
+#include "InstanceRing.h"
+#include "Profiler.h"
+#include <GLFW/glfw3.h>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+//GL 4.4 / ARB_buffer_storage, not part of the GL 3.3 loader
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+static BufferStorageProc bufferStorage = NULL;
+
+static bool hasExtension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension != NULL && strcmp(extension, name) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+InstanceRing::InstanceRing()
+{
+	this->buffer = 0;
+	this->persistent = false;
+	this->capacity = 0;
+	this->region = 0;
+	this->mapped = NULL;
+	this->writing = false;
+	for (int i = 0; i < REGIONS; i++)
+	{
+		this->fences[i] = NULL;
+	}
+	this->uploadedBytes = 0;
+	this->fenceWait = 0.0f;
+}
+
+InstanceRing::~InstanceRing()
+{
+	this->release();
+}
+
+void InstanceRing::init()
+{
+	GLint major = 0;
+	GLint minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major > 4 || (major == 4 && minor >= 4) || hasExtension("GL_ARB_buffer_storage"))
+	{
+		bufferStorage = (BufferStorageProc)glfwGetProcAddress("glBufferStorage");
+	}
+	this->persistent = bufferStorage != NULL;
+	glGenBuffers(1, &this->buffer);
+}
+
+void InstanceRing::allocate(int capacity)
+{
+	//All regions may still be read by the GPU
+	for (int i = 0; i < REGIONS; i++)
+	{
+		this->waitFence(i);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+	if (this->mapped != NULL)
+	{
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		this->mapped = NULL;
+	}
+
+	//Storage of a buffer object is immutable, a larger ring needs a new one
+	glDeleteBuffers(1, &this->buffer);
+	glGenBuffers(1, &this->buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+	this->capacity = capacity;
+	const GLsizeiptr size = (GLsizeiptr)REGIONS * capacity * sizeof(ParticleInstance);
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	bufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+	this->mapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+	if (this->mapped == NULL)
+	{
+		//Keep drawing with orphaning
+		std::cout << "ERROR::INSTANCERING:: Persistent mapping failed, falling back to orphaning" << std::endl;
+		this->persistent = false;
+		glDeleteBuffers(1, &this->buffer);
+		glGenBuffers(1, &this->buffer);
+		this->capacity = 0;
+	}
+}
+
+void InstanceRing::release()
+{
+	if (this->buffer == 0)
+	{
+		return;
+	}
+	for (int i = 0; i < REGIONS; i++)
+	{
+		if (this->fences[i] != NULL)
+		{
+			glDeleteSync(this->fences[i]);
+			this->fences[i] = NULL;
+		}
+	}
+	if (this->mapped != NULL)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		this->mapped = NULL;
+	}
+	glDeleteBuffers(1, &this->buffer);
+	this->buffer = 0;
+}
+
+void InstanceRing::waitFence(int region)
+{
+	if (this->fences[region] == NULL)
+	{
+		return;
+	}
+	ProfileScope scope("FenceWait");
+	const double start = glfwGetTime();
+	GLenum result = GL_TIMEOUT_EXPIRED;
+	while (result == GL_TIMEOUT_EXPIRED)
+	{
+		result = glClientWaitSync(this->fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);
+	}
+	glDeleteSync(this->fences[region]);
+	this->fences[region] = NULL;
+	this->fenceWait += (float)((glfwGetTime() - start) * 1000.0);
+}
+
+void InstanceRing::beginFrame()
+{
+	this->fenceWait = 0.0f;
+	this->uploadedBytes = 0;
+}
+
+void InstanceRing::reserve(int count)
+{
+	//A new buffer waits for all regions: grow by half at least, so a slowly rising count does not stall on the GPU every frame.
+	//allocate falls back to orphaning if the mapping fails
+	if (this->persistent && count > this->capacity)
+	{
+		this->allocate(std::max(count, this->capacity + this->capacity / 2));
+	}
+}
+
+ParticleInstance* InstanceRing::map(int count)
+{
+	this->uploadedBytes = (size_t)count * sizeof(ParticleInstance);
+	count = std::max(count, 1);
+
+	this->reserve(count);
+	if (this->persistent)
+	{
+		//The region written REGIONS frames ago
+		this->region = (this->region + 1) % REGIONS;
+		this->waitFence(this->region);
+		return (ParticleInstance*)(this->mapped + this->getOffset());
+	}
+
+	//Orphaning: a fresh data store every frame, the driver keeps the old one alive for draws in flight
+	glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+	this->capacity = std::max(count, this->capacity);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)this->capacity * sizeof(ParticleInstance), NULL, GL_STREAM_DRAW);
+	this->mapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, (GLsizeiptr)count * sizeof(ParticleInstance), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	this->writing = true;
+	return (ParticleInstance*)this->mapped;
+}
+
+void InstanceRing::unmap()
+{
+	glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+	if (this->writing)
+	{
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		this->mapped = NULL;
+		this->writing = false;
+	}
+}
+
+void InstanceRing::fence()
+{
+	if (this->persistent)
+	{
+		if (this->fences[this->region] != NULL)
+		{
+			glDeleteSync(this->fences[this->region]);
+		}
+		this->fences[this->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+unsigned int InstanceRing::getBuffer()
+{
+	return this->buffer;
+}
+
+size_t InstanceRing::getOffset()
+{
+	return this->persistent ? (size_t)this->region * this->capacity * sizeof(ParticleInstance) : 0;
+}
+
+bool InstanceRing::isPersistent()
+{
+	return this->persistent;
+}
+
+size_t InstanceRing::getUploadedBytes()
+{
+	return this->uploadedBytes;
+}
+
+float InstanceRing::getFenceWait()
+{
+	return this->fenceWait;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "Life3D_Particles.h"
+
+//Streams the instances of every frame to the GPU without glBufferSubData. With GL 4.4 or ARB_buffer_storage the buffer is split into
+//REGIONS regions that are mapped persistently once: every frame writes the next region, a fence after its draw calls tells when the
+//GPU is done reading it, so the CPU only waits if it is REGIONS frames ahead. Plain GL 3.3 falls back to orphaning the buffer and
+//mapping it every frame. Either way the worker threads write the instances straight into the mapped memory.
+class InstanceRing
+{
+public:
+	InstanceRing();
+	~InstanceRing();
+
+	//Needs the current context, picks persistent mapping if supported
+	void init();
+
+	//Starts the statistics of a frame, before reserve and map
+	void beginFrame();
+	//Capacity for count instances per frame without reallocating (the ring never shrinks)
+	void reserve(int count);
+	//Memory for count instances of this frame, written until unmap (any thread). Waits for the fence of the region if needed
+	ParticleInstance* map(int count);
+	//Ends the writes and binds the buffer, the instance attributes have to point at getOffset()
+	void unmap();
+	//After the draw calls reading the region of this frame
+	void fence();
+
+	unsigned int getBuffer();
+	size_t getOffset();
+	bool isPersistent();
+
+	//Frame since beginFrame
+	size_t getUploadedBytes();
+	float getFenceWait(); //Milliseconds, including the wait of a reallocation
+
+	static const int REGIONS = 3;
+
+private:
+	unsigned int buffer;
+	bool persistent;
+	int capacity;   //Instances per region
+	int region;
+	char* mapped;   //Persistent: whole buffer, else the mapping of this frame
+	bool writing;   //Orphaning: buffer is mapped
+	GLsync fences[REGIONS];
+
+	size_t uploadedBytes;
+	float fenceWait;
+
+	void allocate(int capacity);
+	void release();
+	void waitFence(int region);
+};
@@ -1,57 +1,154 @@
 #include "Life3D_Particles.h"
 
 
-Life3D_Particles::Life3D_Particles(glm::vec3 pos, glm::vec3 color)
+Life3D_Particles::Life3D_Particles()
 {
-	this->position = pos;
-	this->model = glm::mat4(1.0f);
-	this->model = glm::scale(this->model, glm::vec3(0.08f));
-	this->model = glm::translate(this->model, pos);
-	this->velocity = glm::vec3(0.0f);
-	this->color = color;
 }
 
-glm::vec3 Life3D_Particles::getPos()
+void Life3D_Particles::add(glm::vec3 pos, int type)
 {
-	return this->position;
+	this->posX.push_back(pos.x);
+	this->posY.push_back(pos.y);
+	this->posZ.push_back(pos.z);
+	this->velX.push_back(0.0f);
+	this->velY.push_back(0.0f);
+	this->velZ.push_back(0.0f);
+	this->type.push_back(type);
+	this->id.push_back((int)this->id.size());
+
+	this->nextPosX.push_back(pos.x);
+	this->nextPosY.push_back(pos.y);
+	this->nextPosZ.push_back(pos.z);
+	this->nextVelX.push_back(0.0f);
+	this->nextVelY.push_back(0.0f);
+	this->nextVelZ.push_back(0.0f);
+
+	this->forceX.push_back(0.0f);
+	this->forceY.push_back(0.0f);
+	this->forceZ.push_back(0.0f);
+}
+
+void Life3D_Particles::clear()
+{
+	this->posX.clear();
+	this->posY.clear();
+	this->posZ.clear();
+	this->velX.clear();
+	this->velY.clear();
+	this->velZ.clear();
+	this->type.clear();
+	this->id.clear();
+
+	this->nextPosX.clear();
+	this->nextPosY.clear();
+	this->nextPosZ.clear();
+	this->nextVelX.clear();
+	this->nextVelY.clear();
+	this->nextVelZ.clear();
+
+	this->forceX.clear();
+	this->forceY.clear();
+	this->forceZ.clear();
 }
 
-glm::mat4 Life3D_Particles::getModel()
+void Life3D_Particles::resize(int count)
 {
-	return this->model;
+	this->posX.resize(count);
+	this->posY.resize(count);
+	this->posZ.resize(count);
+	this->velX.resize(count);
+	this->velY.resize(count);
+	this->velZ.resize(count);
+	this->type.resize(count);
+	this->id.resize(count);
+
+	this->nextPosX.resize(count);
+	this->nextPosY.resize(count);
+	this->nextPosZ.resize(count);
+	this->nextVelX.resize(count);
+	this->nextVelY.resize(count);
+	this->nextVelZ.resize(count);
+
+	this->forceX.resize(count);
+	this->forceY.resize(count);
+	this->forceZ.resize(count);
 }
 
-glm::vec3 Life3D_Particles::getColor()
+int Life3D_Particles::size()
 {
-	return this->color;
+	return (int)this->posX.size();
 }
 
-glm::vec3 Life3D_Particles::getVelocity()
+glm::vec3 Life3D_Particles::getPos(int i)
 {
-	return this->velocity;
+	return glm::vec3(this->posX[i], this->posY[i], this->posZ[i]);
 }
 
-void Life3D_Particles::setPos(glm::vec3 pos)
+glm::vec3 Life3D_Particles::getVelocity(int i)
 {
-	this->position = pos;
+	return glm::vec3(this->velX[i], this->velY[i], this->velZ[i]);
 }
 
-void Life3D_Particles::setVel(glm::vec3 vel)
+void Life3D_Particles::setPos(int i, glm::vec3 pos)
 {
-	this->velocity = vel;
+	this->posX[i] = pos.x;
+	this->posY[i] = pos.y;
+	this->posZ[i] = pos.z;
 }
 
-void Life3D_Particles::setScale(float fac)
+void Life3D_Particles::setVel(int i, glm::vec3 vel)
 {
-	this->scale = fac;
+	this->velX[i] = vel.x;
+	this->velY[i] = vel.y;
+	this->velZ[i] = vel.z;
 }
 
-void Life3D_Particles::update()
+void Life3D_Particles::swap()
 {
-	this->model = glm::mat4(1.0f);
-	this->model = glm::translate(this->model, this->position);
-	this->model = glm::scale(this->model, glm::vec3(this->scale));
+	//Only the buffers are exchanged, no particle data is copied
+	this->posX.swap(this->nextPosX);
+	this->posY.swap(this->nextPosY);
+	this->posZ.swap(this->nextPosZ);
+	this->velX.swap(this->nextVelX);
+	this->velY.swap(this->nextVelY);
+	this->velZ.swap(this->nextVelZ);
 }
 
-float Life3D_Particles::scale = 0.8f;
+void Life3D_Particles::reorder(const int* order)
+{
+	//Gathers into the next state buffers, which are overwritten by the next step anyway
+	const int n = this->size();
+	for (int k = 0; k < n; k++)
+	{
+		this->nextPosX[k] = this->posX[order[k]];
+		this->nextPosY[k] = this->posY[order[k]];
+		this->nextPosZ[k] = this->posZ[order[k]];
+		this->nextVelX[k] = this->velX[order[k]];
+		this->nextVelY[k] = this->velY[order[k]];
+		this->nextVelZ[k] = this->velZ[order[k]];
+	}
+	this->swap();
 
+	this->scratch.resize(n);
+	for (int k = 0; k < n; k++)
+	{
+		this->scratch[k] = this->type[order[k]];
+	}
+	this->type.swap(this->scratch);
+	for (int k = 0; k < n; k++)
+	{
+		this->scratch[k] = this->id[order[k]];
+	}
+	this->id.swap(this->scratch);
+}
+
+void Life3D_Particles::update(ParticleInstance* instances, int begin, int end)
+{
+	//Scale and normals are applied by the shader
+	for (int i = begin; i < end; i++)
+	{
+		ParticleInstance& instance = instances[i];
+		instance.position = glm::vec3(this->posX[i], this->posY[i], this->posZ[i]);
+		instance.color = (unsigned int)this->type[i];
+	}
+}
@@ -1,32 +1,65 @@
 #pragma once
+#include <vector>
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+//Per-instance data of the renderer (16 bytes): the shader adds the scaled sphere to position and looks up the type color in its table
+struct ParticleInstance
+{
+	glm::vec3 position;
+	unsigned int color; //Type, or an RGB8 color (0x00RRGGBB) with INSTANCE_RGB set
+};
 
+static const unsigned int INSTANCE_RGB = 0x80000000u;
 
+//Structure of arrays particle store: every attribute lives in its own contiguous array, indexed by particle
 class Life3D_Particles
 {
 public:
-	Life3D_Particles(glm::vec3 pos, glm::vec3 color);
+	Life3D_Particles();
+
+	void add(glm::vec3 pos, int type);
+	void clear();
+	void resize(int count); //All arrays to count particles, for filling them in directly
+	int size();
+
+	glm::vec3 getPos(int i);
+	glm::vec3 getVelocity(int i);
+
+	void setPos(int i, glm::vec3 pos);
+	void setVel(int i, glm::vec3 vel);
+
+	void swap(); //Next state becomes the current state
+	void reorder(const int* order); //Particle order[k] moves to index k, the next state and the forces are not kept
+
+	void update(ParticleInstance* instances, int begin, int end); //Instances with type colors for the particle range [begin, end)
 
-	glm::vec3 getPos();
-	glm::mat4 getModel();
-	glm::vec3 getColor();
-	glm::vec3 getVelocity();
+	//Current state (public for the hot loops), read only while a step is running
+	std::vector<float> posX;
+	std::vector<float> posY;
+	std::vector<float> posZ;
+	std::vector<float> velX;
+	std::vector<float> velY;
+	std::vector<float> velZ;
+	std::vector<int> type;
+	std::vector<int> id; //Index at creation, follows the particle through reorders
 
-	void setPos(glm::vec3 pos);
-	void setVel(glm::vec3 vel);
-	void setScale(float fac);
+	//Next state, written by the integration pass
+	std::vector<float> nextPosX;
+	std::vector<float> nextPosY;
+	std::vector<float> nextPosZ;
+	std::vector<float> nextVelX;
+	std::vector<float> nextVelY;
+	std::vector<float> nextVelZ;
 
-	void update(); //Modelupdate
+	//Accumulated force per particle, written by the force pass
+	std::vector<float> forceX;
+	std::vector<float> forceY;
+	std::vector<float> forceZ;
 
 private:
-	glm::vec3 position; 
-	glm::vec3 velocity; 
-	glm::mat4 model; 
-	glm::vec3 color;   
-	static float scale;
-	
+	std::vector<int> scratch;
 };
 
@@ -0,0 +1,131 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+	this->data = NULL;
+	this->size = 0;
+	this->file = NULL;
+	this->mapping = NULL;
+	this->descriptor = -1;
+}
+
+MappedFile::~MappedFile()
+{
+	this->close();
+}
+
+bool MappedFile::open(const std::string& fileName, bool sequential)
+{
+	this->close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	const unsigned char* data = NULL;
+	if (mapping)
+	{
+		data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+	if (!data)
+	{
+		if (mapping)
+		{
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+		return false;
+	}
+	this->file = file;
+	this->mapping = mapping;
+	this->size = (size_t)size.QuadPart;
+	this->data = data;
+#else
+	int descriptor = ::open(fileName.c_str(), O_RDONLY);
+	if (descriptor < 0)
+	{
+		return false;
+	}
+	struct stat info;
+	if (fstat(descriptor, &info) != 0 || info.st_size == 0)
+	{
+		::close(descriptor);
+		return false;
+	}
+	size_t size = (size_t)info.st_size;
+	int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+	if (sequential)
+	{
+		//Fault the pages in at once instead of one by one during the copy
+		flags |= MAP_POPULATE;
+	}
+#endif
+	void* data = mmap(NULL, size, PROT_READ, flags, descriptor, 0);
+	if (data == MAP_FAILED)
+	{
+		::close(descriptor);
+		return false;
+	}
+	madvise(data, size, sequential ? MADV_SEQUENTIAL : MADV_NORMAL);
+	this->descriptor = descriptor;
+	this->size = size;
+	this->data = (const unsigned char*)data;
+#endif
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (!this->data)
+	{
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(this->data);
+	CloseHandle((HANDLE)this->mapping);
+	CloseHandle((HANDLE)this->file);
+	this->file = NULL;
+	this->mapping = NULL;
+#else
+	munmap((void*)this->data, this->size);
+	::close(this->descriptor);
+	this->descriptor = -1;
+#endif
+	this->data = NULL;
+	this->size = 0;
+}
+
+bool MappedFile::isOpen()
+{
+	return this->data != NULL;
+}
+
+const unsigned char* MappedFile::getData()
+{
+	return this->data;
+}
+
+size_t MappedFile::getSize()
+{
+	return this->size;
+}
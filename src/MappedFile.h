@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+//Read only view of a whole file
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	//sequential: the file is read once front to back right away (pages are faulted in at once), false = random access
+	bool open(const std::string& fileName, bool sequential);
+	void close();
+
+	bool isOpen();
+	const unsigned char* getData();
+	size_t getSize();
+
+private:
+	const unsigned char* data;
+	size_t size;
+	//File and mapping handles (HANDLE on Windows), file descriptor otherwise
+	void* file;
+	void* mapping;
+	int descriptor;
+};
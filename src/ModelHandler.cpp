@@ -8,16 +8,23 @@ ModelHandler::ModelHandler(string path)
 	this->rotationAxis = glm::vec3(1.0f);
 	this->rotationAngle = 0.0f;
 	this->scale = 0.0f;
+	this->program = 0;
+	this->modelLocation = -1;
+	this->colorLocation = -1;
 }
 
-void ModelHandler::Draw(Shader *s, glm::mat4 projection, glm::mat4 view, glm::vec3 color)
+void ModelHandler::Draw(Shader *s, glm::vec3 color)
 {
 	this->Transform();
 	s->use();
-	s->setMat4("projection", projection);
-	s->setMat4("view", view);
-	s->setMat4("model", this->transformation);
-	s->setVec3("color", color);
+	if (s->ID != this->program)
+	{
+		this->program = s->ID;
+		this->modelLocation = s->getUniformLocation("model");
+		this->colorLocation = s->getUniformLocation("color");
+	}
+	s->setMat4(this->modelLocation, this->transformation);
+	s->setVec3(this->colorLocation, color);
 
 	this->model->Draw(*s);
 }
@@ -6,7 +6,8 @@ class ModelHandler
 {
 public: 
 	ModelHandler(string path);
-	void Draw(Shader *s, glm::mat4 projection, glm::mat4 view, glm::vec3 color);
+	//Projection and view come from the Frame uniform block of the shader
+	void Draw(Shader *s, glm::vec3 color);
 	void Translate(glm::vec3 direction);
 	void Rotate(float angle, glm::vec3 axis);
 	void Scale(float factor);
@@ -23,6 +24,11 @@ private:
 	float rotationAngle;
 	float scale;
 
+	//Uniform locations in the program of the last Draw
+	unsigned int program;
+	int modelLocation;
+	int colorLocation;
+
 	void Transform();
 };
 
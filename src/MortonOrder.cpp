@@ -0,0 +1,107 @@
+#include "MortonOrder.h"
+#include <algorithm>
+
+MortonOrder::MortonOrder()
+{
+}
+
+void MortonOrder::compute(Life3D_Particles& particles, float cubeSize, ThreadPool* threadPool)
+{
+	const int n = particles.size();
+	const int cells = 1 << BITS;
+	const float scale = cells / (2.0f * cubeSize);
+
+	this->keys.resize(n);
+	this->keysTmp.resize(n);
+	this->order.resize(n);
+	this->orderTmp.resize(n);
+
+	//Morton code of every particle's cell, particles outside of the box are clamped into the outer cells
+	threadPool->parallelFor(0, n, 4096, [&](int begin, int end, int worker) {
+		for (int i = begin; i < end; i++)
+		{
+			int cx = std::max(0, std::min((int)((particles.posX[i] + cubeSize) * scale), cells - 1));
+			int cy = std::max(0, std::min((int)((particles.posY[i] + cubeSize) * scale), cells - 1));
+			int cz = std::max(0, std::min((int)((particles.posZ[i] + cubeSize) * scale), cells - 1));
+			this->keys[i] = expandBits(cx) | (expandBits(cy) << 1) | (expandBits(cz) << 2);
+			this->order[i] = i;
+		}
+	});
+
+	//Fixed blocks, so the scatter offsets of every block are known before scattering
+	const int blocks = std::max(1, std::min(threadPool->getThreadCount() * 4, n / 1024));
+	const int blockSize = (n + blocks - 1) / blocks;
+	this->histogram.resize(blocks * RADIX);
+
+	for (int shift = 0; shift < 3 * BITS; shift += RADIX_BITS)
+	{
+		//Histogram of the current digit per block
+		threadPool->parallelFor(0, blocks, 1, [&](int blockBegin, int blockEnd, int worker) {
+			for (int block = blockBegin; block < blockEnd; block++)
+			{
+				int* count = &this->histogram[block * RADIX];
+				std::fill(count, count + RADIX, 0);
+				for (int i = block * blockSize; i < std::min(n, (block + 1) * blockSize); i++)
+				{
+					count[(this->keys[i] >> shift) & (RADIX - 1)]++;
+				}
+			}
+		});
+
+		//Exclusive prefix sum digit major, block minor: lower blocks scatter first, the sort stays stable
+		int offset = 0;
+		for (int digit = 0; digit < RADIX; digit++)
+		{
+			for (int block = 0; block < blocks; block++)
+			{
+				int count = this->histogram[block * RADIX + digit];
+				this->histogram[block * RADIX + digit] = offset;
+				offset += count;
+			}
+		}
+
+		threadPool->parallelFor(0, blocks, 1, [&](int blockBegin, int blockEnd, int worker) {
+			for (int block = blockBegin; block < blockEnd; block++)
+			{
+				int* fill = &this->histogram[block * RADIX];
+				for (int i = block * blockSize; i < std::min(n, (block + 1) * blockSize); i++)
+				{
+					int target = fill[(this->keys[i] >> shift) & (RADIX - 1)]++;
+					this->keysTmp[target] = this->keys[i];
+					this->orderTmp[target] = this->order[i];
+				}
+			}
+		});
+
+		this->keys.swap(this->keysTmp);
+		this->order.swap(this->orderTmp);
+	}
+
+	this->inverse.resize(n);
+	threadPool->parallelFor(0, n, 4096, [this](int begin, int end, int worker) {
+		for (int k = begin; k < end; k++)
+		{
+			this->inverse[this->order[k]] = k;
+		}
+	});
+}
+
+const int* MortonOrder::getOrder()
+{
+	return this->order.data();
+}
+
+const int* MortonOrder::getInverse()
+{
+	return this->inverse.data();
+}
+
+unsigned int MortonOrder::expandBits(unsigned int v)
+{
+	//Spreads 10 bits so that two zero bits lie between each of them
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+
+#include "Life3D_Particles.h"
+#include "ThreadPool.h"
+
+//Z-order of the particles: the box is split into 2^BITS cells per axis, the interleaved cell coordinates (Morton code) are sorted with a parallel LSD radix sort.
+//Particles that are close in space end up close in memory, which keeps the neighbour fetches and the instance upload cache friendly.
+class MortonOrder
+{
+public:
+	MortonOrder();
+
+	//order[k] = index of the particle that moves to position k, stable for equal codes
+	void compute(Life3D_Particles& particles, float cubeSize, ThreadPool* threadPool);
+	const int* getOrder();
+	//inverse[i] = new index of particle i
+	const int* getInverse();
+
+	static const int BITS = 10;
+
+private:
+	std::vector<unsigned int> keys;
+	std::vector<unsigned int> keysTmp;
+	std::vector<int> order;
+	std::vector<int> orderTmp;
+	std::vector<int> inverse;
+
+	//Digit histograms per block, turned into scatter offsets
+	std::vector<int> histogram;
+
+	static const int RADIX_BITS = 10;
+	static const int RADIX = 1 << RADIX_BITS;
+
+	static unsigned int expandBits(unsigned int v);
+};
+
@@ -0,0 +1,233 @@
+#include "NeighbourList.h"
+#include "ForceKernel.h"
+#include <algorithm>
+#include <cmath>
+
+static inline float minimumImage(float d, float period)
+{
+	//Nearest copy in the periodic box, period 0 = no wrapping
+	if (period > 0.0f)
+	{
+		d -= period * std::floor(d / period + 0.5f);
+	}
+	return d;
+}
+
+NeighbourList::NeighbourList()
+{
+	this->builtCutoff = 0.0f;
+	this->builtCubeSize = 0.0f;
+	this->builtPeriod = 0.0f;
+	this->valid = false;
+	this->built = false;
+
+	this->stats.active = false;
+	this->stats.steps = 0;
+	this->stats.rebuilds = 0;
+	this->stats.averageLength = 0.0f;
+	this->stats.rebuildInterval = 0.0f;
+}
+
+bool NeighbourList::needsRebuild(Life3D_Particles& particles, float cutoff, float cubeSize, float period, float skin, ThreadPool* threadPool)
+{
+	const int n = particles.size();
+	if (!this->built || (int)this->refX.size() != n || cutoff != this->builtCutoff || cubeSize != this->builtCubeSize || period != this->builtPeriod)
+	{
+		return true;
+	}
+
+	//Largest displacement since the build, every worker keeps its own maximum
+	this->workerMax.assign(threadPool->getThreadCount(), 0.0f);
+	threadPool->parallelFor(0, n, 4096, [this, &particles, period](int begin, int end, int worker) {
+		float maxD2 = this->workerMax[worker];
+		for (int i = begin; i < end; i++)
+		{
+			//Wrapping around the periodic box is no displacement
+			float dx = minimumImage(particles.posX[i] - this->refX[i], period);
+			float dy = minimumImage(particles.posY[i] - this->refY[i], period);
+			float dz = minimumImage(particles.posZ[i] - this->refZ[i], period);
+			maxD2 = std::max(maxD2, dx * dx + dy * dy + dz * dz);
+		}
+		this->workerMax[worker] = maxD2;
+	});
+
+	float maxD2 = *std::max_element(this->workerMax.begin(), this->workerMax.end());
+	float limit = 0.5f * skin;
+	return maxD2 > limit * limit;
+}
+
+bool NeighbourList::build(SpatialGrid& grid, Life3D_Particles& particles, float cutoff, float cubeSize, float period, ThreadPool* threadPool)
+{
+	const int n = particles.size();
+	const int cells = grid.getCellsPerAxis();
+	const int types = grid.getTypeCount();
+	const float cutoff2 = cutoff * cutoff;
+	const bool periodic = period > 0.0f;
+	const float* x = grid.getSortedX();
+	const float* y = grid.getSortedY();
+	const float* z = grid.getSortedZ();
+	const int* bucketStart = grid.getBucketStart();
+
+	this->start.assign(n + 1, 0);
+
+	//Pass 1: every block of particles collects its lists into its own buffer, branchless (most candidates are rejected)
+	const int blockCount = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	this->blocks.resize(blockCount);
+	threadPool->parallelFor(0, blockCount, 1, [&](int blockBegin, int blockEnd, int worker) {
+		for (int block = blockBegin; block < blockEnd; block++)
+		{
+			std::vector<int>& buffer = this->blocks[block];
+			buffer.clear();
+			int size = 0;
+
+			for (int k = block * BLOCK_SIZE; k < std::min(n, (block + 1) * BLOCK_SIZE); k++)
+			{
+				const float px = x[k];
+				const float py = y[k];
+				const float pz = z[k];
+				const int listBegin = size;
+
+				//Same cell walk as the cell kernel
+				int cellY[3];
+				int cellZ[3];
+				int spanFirst[2];
+				int spanLast[2];
+				const int countY = neighbourCells(grid.cellCoord(py), cells, periodic, cellY);
+				const int countZ = neighbourCells(grid.cellCoord(pz), cells, periodic, cellZ);
+				const int spans = neighbourSpans(grid.cellCoord(px), cells, periodic, spanFirst, spanLast);
+
+				for (int iz = 0; iz < countZ; iz++)
+				{
+					for (int iy = 0; iy < countY; iy++)
+					{
+						for (int span = 0; span < spans; span++)
+						{
+							const int row = (cellZ[iz] * cells + cellY[iy]) * cells;
+							const int first = bucketStart[(row + spanFirst[span]) * types];
+							const int last = bucketStart[(row + spanLast[span] + 1) * types];
+
+							buffer.resize(size + (last - first));
+							int* out = buffer.data();
+							for (int m = first; m < last; m++)
+							{
+								float dx = minimumImage(x[m] - px, period);
+								float dy = minimumImage(y[m] - py, period);
+								float dz = minimumImage(z[m] - pz, period);
+								out[size] = m;
+								size += (m != k) & (dx * dx + dy * dy + dz * dz < cutoff2);
+							}
+						}
+					}
+				}
+				this->start[k + 1] = size - listBegin;
+			}
+			buffer.resize(size);
+		}
+	});
+
+	//Prefix sum over the list lengths
+	long long total = 0;
+	for (int k = 0; k < n; k++)
+	{
+		total += this->start[k + 1];
+		this->start[k + 1] = (int)std::min(total, MAX_ENTRIES + 1);
+	}
+
+	//Reference positions are kept even if the lists are too large, so the next attempt waits for the next trigger
+	this->refX = particles.posX;
+	this->refY = particles.posY;
+	this->refZ = particles.posZ;
+	this->builtCutoff = cutoff;
+	this->builtCubeSize = cubeSize;
+	this->builtPeriod = period;
+	this->built = true;
+	this->stats.rebuilds++;
+	this->stats.averageLength = n > 0 ? (float)((double)total / n) : 0.0f;
+
+	if (total > MAX_ENTRIES)
+	{
+		this->valid = false;
+		this->stats.active = false;
+		this->neighbours.clear();
+		this->neighbourTypes.clear();
+		this->blocks.clear();
+		return false;
+	}
+
+	//Pass 2: copy the blocks into the CSR arrays, padded for full width vector loads past the last list
+	const int* type = grid.getSortedType();
+	this->neighbours.resize(total + SpatialGrid::PADDING);
+	this->neighbourTypes.resize(total + SpatialGrid::PADDING);
+	std::fill(this->neighbours.begin() + total, this->neighbours.end(), 0);
+	std::fill(this->neighbourTypes.begin() + total, this->neighbourTypes.end(), 0);
+
+	threadPool->parallelFor(0, blockCount, 1, [&](int blockBegin, int blockEnd, int worker) {
+		for (int block = blockBegin; block < blockEnd; block++)
+		{
+			const std::vector<int>& buffer = this->blocks[block];
+			const int offset = this->start[block * BLOCK_SIZE];
+			for (int e = 0; e < (int)buffer.size(); e++)
+			{
+				this->neighbours[offset + e] = buffer[e];
+				this->neighbourTypes[offset + e] = type[buffer[e]];
+			}
+		}
+	});
+
+	this->valid = true;
+	this->stats.active = true;
+	return true;
+}
+
+void NeighbourList::invalidate()
+{
+	this->built = false;
+	this->valid = false;
+}
+
+void NeighbourList::reorder(const int* order)
+{
+	const int n = (int)this->refX.size();
+	std::vector<float>* ref[3] = { &this->refX, &this->refY, &this->refZ };
+	for (int axis = 0; axis < 3; axis++)
+	{
+		std::vector<float>& values = *ref[axis];
+		this->scratch.resize(n);
+		for (int k = 0; k < n; k++)
+		{
+			this->scratch[k] = values[order[k]];
+		}
+		values.swap(this->scratch);
+	}
+}
+
+void NeighbourList::countStep()
+{
+	this->stats.steps++;
+	this->stats.rebuildInterval = this->stats.rebuilds > 0 ? (float)this->stats.steps / this->stats.rebuilds : 0.0f;
+}
+
+bool NeighbourList::isValid()
+{
+	return this->valid;
+}
+
+const int* NeighbourList::getStart()
+{
+	return this->start.data();
+}
+
+const int* NeighbourList::getNeighbours()
+{
+	return this->neighbours.data();
+}
+
+const int* NeighbourList::getNeighbourTypes()
+{
+	return this->neighbourTypes.data();
+}
+
+NeighbourListStats NeighbourList::getStats()
+{
+	return this->stats;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <vector>
+
+#include "Life3D_Particles.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+
+//Rebuild statistics for the GUI and the headless runner
+struct NeighbourListStats
+{
+	bool active;           //false while the lists would exceed MAX_ENTRIES (cell kernel is used instead)
+	int steps;
+	int rebuilds;
+	float averageLength;   //Neighbours per particle of the last build
+	float rebuildInterval; //Steps per rebuild
+};
+
+//Verlet neighbour lists: every particle caches all neighbours within distanceMax + skin in grid order.
+//The lists stay valid until some particle has moved more than skin / 2 since the build, so the grid search only runs on rebuilds.
+//Layout is CSR: the neighbours of sorted particle k are neighbours[start[k], start[k + 1]), indices refer to the sorted arrays of the grid.
+class NeighbourList
+{
+public:
+	NeighbourList();
+
+	//True if the cutoff, the box, the boundary, the particle count changed or a particle moved too far.
+	//period is the box edge for periodic boundaries (minimum image distances), 0 otherwise.
+	bool needsRebuild(Life3D_Particles& particles, float cutoff, float cubeSize, float period, float skin, ThreadPool* threadPool);
+	//grid has to be built with a cell size of at least cutoff, returns false if the lists would get too large
+	bool build(SpatialGrid& grid, Life3D_Particles& particles, float cutoff, float cubeSize, float period, ThreadPool* threadPool);
+	void invalidate();
+	//Follows a permutation of the particle arrays (particle order[k] moved to k), the lists itself are in grid order and stay valid
+	void reorder(const int* order);
+	void countStep();
+
+	bool isValid();
+	const int* getStart();
+	const int* getNeighbours();
+	const int* getNeighbourTypes();
+
+	NeighbourListStats getStats();
+
+	//int entries, 2 arrays: 64M entries = 512 MB
+	static const long long MAX_ENTRIES = 64LL * 1024 * 1024;
+
+private:
+	std::vector<int> start;
+	std::vector<int> neighbours;
+	std::vector<int> neighbourTypes;
+
+	//Positions at the last build
+	std::vector<float> refX;
+	std::vector<float> refY;
+	std::vector<float> refZ;
+	std::vector<float> scratch;
+
+	float builtCutoff;
+	float builtCubeSize;
+	float builtPeriod;
+	bool valid;
+	bool built;
+
+	//Per worker results
+	std::vector<float> workerMax;
+
+	//Lists of BLOCK_SIZE particles each, collected before the final offsets are known
+	std::vector<std::vector<int>> blocks;
+	static const int BLOCK_SIZE = 256;
+
+	NeighbourListStats stats;
+};
+
@@ -0,0 +1,277 @@
+#include "Profiler.h"
+#include <map>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <iostream>
+
+std::atomic<bool> Profiler::enabled(false);
+
+struct ProfileEvent
+{
+	const char* name;
+	long long start;
+	long long end;
+	int thread;
+};
+
+//Events of one thread since the last endFrame, the thread only waits for its own mutex while endFrame takes the events
+struct ProfileThread
+{
+	std::mutex mutex;
+	std::vector<ProfileEvent> events;
+	int thread;
+	bool exited;
+};
+
+//Time of one phase on one thread per frame, ring of HISTORY frames
+struct ProfileSeries
+{
+	std::vector<float> samples;
+	int count; //Frames since the phase ran first, at most HISTORY
+	int idle;  //Frames since the phase ran last, dropped after HISTORY frames
+};
+
+//Registry of all threads, threads register on their first event
+static std::mutex threadMutex;
+static std::vector<ProfileThread*> threads;
+static std::map<int, std::string> threadNames; //Kept after a thread exited, its events may still be traced
+static int nextThread = 0;
+
+//Main thread only
+static std::map<std::pair<int, std::string>, ProfileSeries> series;
+static std::vector<float> frameTimes;
+static int historyIndex = 0; //Ring position of the next frame in every series
+static std::deque<std::vector<ProfileEvent>> traceFrames;
+static long long lastFrame = -1;
+static bool wasEnabled = false;
+
+//Marks the buffer of a thread as exited when the thread ends, endFrame deletes it after taking the last events
+struct ProfileThreadOwner
+{
+	ProfileThread* buffer = NULL;
+
+	~ProfileThreadOwner()
+	{
+		if (this->buffer != NULL)
+		{
+			std::lock_guard<std::mutex> lock(this->buffer->mutex);
+			this->buffer->exited = true;
+		}
+	}
+};
+
+static thread_local ProfileThreadOwner threadOwner;
+
+static ProfileThread* currentThread()
+{
+	if (threadOwner.buffer == NULL)
+	{
+		ProfileThread* buffer = new ProfileThread();
+		buffer->exited = false;
+		std::lock_guard<std::mutex> lock(threadMutex);
+		buffer->thread = nextThread++;
+		threadNames[buffer->thread] = "Thread " + std::to_string(buffer->thread);
+		threads.push_back(buffer);
+		threadOwner.buffer = buffer;
+	}
+	return threadOwner.buffer;
+}
+
+void Profiler::setEnabled(bool enabled)
+{
+	Profiler::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Profiler::setThreadName(const std::string& name)
+{
+	ProfileThread* buffer = currentThread();
+	std::lock_guard<std::mutex> lock(threadMutex);
+	threadNames[buffer->thread] = name;
+}
+
+long long Profiler::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::record(const char* name, long long start, long long end)
+{
+	ProfileThread* buffer = currentThread();
+	std::lock_guard<std::mutex> lock(buffer->mutex);
+	buffer->events.push_back({ name, start, end, buffer->thread });
+}
+
+//Main thread------------------------------------------------------------------------------
+
+void Profiler::endFrame()
+{
+	//Events recorded until the profiler was disabled are dropped once
+	const bool active = isEnabled();
+	if (!active && !wasEnabled)
+	{
+		return;
+	}
+	const long long time = now();
+	const bool complete = active && wasEnabled;
+	std::vector<ProfileEvent> frame;
+	if (complete)
+	{
+		frame.push_back({ "Frame", lastFrame, time, currentThread()->thread });
+	}
+	lastFrame = time;
+	wasEnabled = active;
+
+	{
+		std::lock_guard<std::mutex> lock(threadMutex);
+		for (int i = 0; i < (int)threads.size(); i++)
+		{
+			ProfileThread* buffer = threads[i];
+			bool exited;
+			{
+				std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+				frame.insert(frame.end(), buffer->events.begin(), buffer->events.end());
+				buffer->events.clear();
+				exited = buffer->exited;
+			}
+			if (exited)
+			{
+				delete buffer;
+				threads.erase(threads.begin() + i);
+				i--;
+			}
+		}
+	}
+	if (!complete)
+	{
+		return;
+	}
+
+	//Time of every phase per thread in this frame, phases that did not run count as 0
+	std::map<std::pair<int, std::string>, double> sums;
+	for (const ProfileEvent& event : frame)
+	{
+		sums[std::make_pair(event.thread, std::string(event.name))] += (event.end - event.start) * 1e-6;
+	}
+	for (const auto& sum : sums)
+	{
+		ProfileSeries& s = series[sum.first];
+		if (s.samples.empty())
+		{
+			s.samples.assign(HISTORY, 0.0f);
+			s.count = 0;
+			s.idle = 0;
+		}
+	}
+	for (auto it = series.begin(); it != series.end();)
+	{
+		auto sum = sums.find(it->first);
+		it->second.samples[historyIndex] = sum != sums.end() ? (float)sum->second : 0.0f;
+		it->second.count = std::min(it->second.count + 1, HISTORY);
+		it->second.idle = sum != sums.end() ? 0 : it->second.idle + 1;
+		if (it->second.idle >= HISTORY)
+		{
+			it = series.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+	historyIndex = (historyIndex + 1) % HISTORY;
+
+	frameTimes.push_back((float)((frame[0].end - frame[0].start) * 1e-6));
+	if ((int)frameTimes.size() > HISTORY)
+	{
+		frameTimes.erase(frameTimes.begin());
+	}
+
+	traceFrames.push_back(std::move(frame));
+	if ((int)traceFrames.size() > TRACE_FRAMES)
+	{
+		traceFrames.pop_front();
+	}
+}
+
+std::vector<ProfileStats> Profiler::getStats()
+{
+	std::lock_guard<std::mutex> lock(threadMutex);
+	std::vector<ProfileStats> stats;
+	std::vector<float> sorted;
+	for (const auto& s : series)
+	{
+		//Frames before the phase ran first are not part of the history
+		const int count = s.second.count;
+		sorted.clear();
+		for (int i = 1; i <= count; i++)
+		{
+			sorted.push_back(s.second.samples[(historyIndex - i + HISTORY) % HISTORY]);
+		}
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0.0;
+		for (float sample : sorted)
+		{
+			total += sample;
+		}
+		ProfileStats stat;
+		stat.name = s.first.second;
+		stat.thread = threadNames[s.first.first];
+		stat.mean = total / count;
+		stat.p50 = sorted[count / 2];
+		stat.p95 = sorted[count * 95 / 100];
+		stat.p99 = sorted[count * 99 / 100];
+		stat.max = sorted.back();
+		stats.push_back(stat);
+	}
+	return stats;
+}
+
+std::vector<float> Profiler::getFrameTimes()
+{
+	return frameTimes;
+}
+
+bool Profiler::writeTrace(const std::string& fileName)
+{
+	std::ofstream file(fileName);
+	if (!file)
+	{
+		std::cout << "ERROR::PROFILER:: Could not open " << fileName << std::endl;
+		return false;
+	}
+
+	//Complete events ("X") in microseconds relative to the first traced frame, one trace thread per thread
+	const long long origin = traceFrames.empty() ? 0 : traceFrames.front()[0].start;
+	file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	bool first = true;
+	{
+		std::lock_guard<std::mutex> lock(threadMutex);
+		for (const auto& name : threadNames)
+		{
+			file << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << name.first
+				<< ", \"args\": {\"name\": \"" << name.second << "\"}}";
+			file << ",\n{\"name\": \"thread_sort_index\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << name.first << ", \"args\": {\"sort_index\": " << name.first << "}}";
+			first = false;
+		}
+	}
+	file.precision(3);
+	file << std::fixed;
+	for (const std::vector<ProfileEvent>& frame : traceFrames)
+	{
+		for (const ProfileEvent& event : frame)
+		{
+			file << (first ? "" : ",\n") << "{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.thread
+				<< ", \"ts\": " << (event.start - origin) * 1e-3 << ", \"dur\": " << (event.end - event.start) * 1e-3 << "}";
+			first = false;
+		}
+	}
+	file << "\n]}\n";
+	if (!file)
+	{
+		std::cout << "ERROR::PROFILER:: Could not write " << fileName << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+
+//Frame profiler: ProfileScope measures a phase on whatever thread it runs on. Once per frame endFrame collects the events of all
+//threads, adds up the time of every phase per thread and keeps the last HISTORY frames for percentiles. The events of the last
+//TRACE_FRAMES frames can be written as Chrome trace (about:tracing or ui.perfetto.dev). While disabled a scope costs one atomic load.
+//Times are CPU times, GL calls only show the time to submit them (waiting for the GPU ends up in SwapBuffers).
+
+//Milliseconds per frame over the history
+struct ProfileStats
+{
+	std::string name;
+	std::string thread;
+	double mean;
+	double p50;
+	double p95;
+	double p99;
+	double max;
+};
+
+class Profiler
+{
+public:
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	//Name of the calling thread in statistics and traces
+	static void setThreadName(const std::string& name);
+
+	//Nanoseconds of the steady clock
+	static long long now();
+	//name has to outlive the profiler (string literal)
+	static void record(const char* name, long long start, long long end);
+
+	//Main thread------------------------------------------------------------------------------
+
+	//Collects the events of all threads, the time since the last call is recorded as "Frame"
+	static void endFrame();
+	//Phases ordered by thread (first seen first) and name
+	static std::vector<ProfileStats> getStats();
+	//Frame times in milliseconds, oldest first
+	static std::vector<float> getFrameTimes();
+	static bool writeTrace(const std::string& fileName);
+
+	static constexpr int HISTORY = 300;
+	static constexpr int TRACE_FRAMES = 120;
+
+private:
+	static std::atomic<bool> enabled;
+};
+
+inline bool Profiler::isEnabled()
+{
+	return enabled.load(std::memory_order_relaxed);
+}
+
+//Records the time from construction to destruction under name
+class ProfileScope
+{
+public:
+	ProfileScope(const char* name)
+	{
+		this->name = name;
+		this->start = Profiler::isEnabled() ? Profiler::now() : -1;
+	}
+
+	~ProfileScope()
+	{
+		if (this->start >= 0)
+		{
+			Profiler::record(this->name, this->start, Profiler::now());
+		}
+	}
+
+private:
+	const char* name;
+	long long start;
+};
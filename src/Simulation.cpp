@@ -1,6 +1,8 @@
 #include "Simulation.h"
-#include <thread>
 #include <random>
+#include <algorithm>
+#include <cstddef>
+#include <limits>
 
 // Base Colors
 #define RED glm::vec3(1.0f, 0.0f, 0.0f)
@@ -53,7 +55,59 @@
 #define NEON_BLUE glm::vec3(0.29f, 0.59f, 0.95f)
 #define NEON_PURPLE glm::vec3(0.67f, 0.29f, 0.95f)
 
-Simulation::Simulation(GLFWwindow* window, int WINDOW_WIDTH, int WINDOW_HEIGHT, int amount)
+//Type colors, the first five are the classic red, green, blue, yellow and white
+static const glm::vec3 TYPE_COLORS[] = {
+	RED, GREEN, BLUE, YELLOW, WHITE,
+	ORANGE, PURPLE, CYAN, MAGENTA,
+	PASTEL_PINK, PASTEL_YELLOW, PASTEL_BLUE, PASTEL_GREEN, PASTEL_PURPLE,
+	GOLD, SILVER, BRONZE, COPPER, STEEL,
+	VIOLET, INDIGO, BLUE_GREEN, YELLOW_GREEN, YELLOW_ORANGE, RED_ORANGE,
+	BROWN, SAND, OLIVE, MOSS_GREEN, SLATE_GRAY,
+	NEON_PINK, NEON_YELLOW, NEON_GREEN, NEON_BLUE, NEON_PURPLE
+};
+
+//Random color of an instance, 8 bits per channel
+static unsigned int packColor(const glm::vec3& color)
+{
+	glm::uvec3 c = glm::uvec3(glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f);
+	return INSTANCE_RGB | (c.r << 16) | (c.g << 8) | c.b;
+}
+
+//Center and radius of the smallest sphere around the vertices that is centered at their mean
+static void boundingSphere(Model* model, glm::vec3& center, float& radius)
+{
+	glm::vec3 sum = glm::vec3(0.0f);
+	int vertexCount = 0;
+	for (const Mesh& mesh : model->meshes)
+	{
+		for (const Vertex& vertex : mesh.vertices)
+		{
+			sum += vertex.Position;
+			vertexCount++;
+		}
+	}
+	center = vertexCount > 0 ? sum / (float)vertexCount : glm::vec3(0.0f);
+	radius = 0.0f;
+	for (const Mesh& mesh : model->meshes)
+	{
+		for (const Vertex& vertex : mesh.vertices)
+		{
+			radius = std::max(radius, glm::length(vertex.Position - center));
+		}
+	}
+}
+
+static int triangleCount(Model* model)
+{
+	int indices = 0;
+	for (const Mesh& mesh : model->meshes)
+	{
+		indices += (int)mesh.indices.size();
+	}
+	return indices / 3;
+}
+
+Simulation::Simulation(GLFWwindow* window, int WINDOW_WIDTH, int WINDOW_HEIGHT, int amount, int typeCount)
 {
 	this->window = window;
 	this->WINDOW_WIDTH = WINDOW_WIDTH;
@@ -63,10 +117,20 @@ Simulation::Simulation(GLFWwindow* window, int WINDOW_WIDTH, int WINDOW_HEIGHT,
 	this->initShader();
 	this->initVertices();
 	this->initVariables();
+
+	//Controls start with the settings of the core and the clock, from here on the core belongs to the simulation thread
+	SimulationCore* core = new SimulationCore(this->amount, typeCount, this->threadCount, this->pinThreads);
+	SimulationClock clock;
+	this->controls.settings = core->settings;
+	this->controls.attraction.assign(core->getAttractionData(), core->getAttractionData() + core->getTypeCount() * core->getTypeCount());
+	this->controls.fixedTimestep = clock.fixedTimestep;
+	this->controls.fixedStep = clock.fixedStep;
+	this->controls.maxSubsteps = clock.maxSubsteps;
+	this->controls.budget = clock.budget;
+	this->simThread = new SimulationThread(core, this->controls);
 	this->initModels();
 	this->initParticles();
 	this->initBuffer();
-	this->randomAttraction();
 
 	//ImGUI Setup
 	IMGUI_CHECKVERSION();
@@ -78,6 +142,14 @@ Simulation::Simulation(GLFWwindow* window, int WINDOW_WIDTH, int WINDOW_HEIGHT,
 
 }
 
+Simulation::~Simulation()
+{
+	//Stops the simulation thread, an open recording gets its index
+	this->player.close();
+	delete this->simThread;
+	delete this->renderPool;
+}
+
 void Simulation::update(float deltaTime, int FPS, Camera camera)
 {
 	//Update view and projection matrix
@@ -88,53 +160,54 @@ void Simulation::update(float deltaTime, int FPS, Camera camera)
 	this->FPS = FPS;
 	this->camera = camera;
 
-	this->processInput(deltaTime);
-
-	if (this->start)
 	{
-		//Multithreading for parallel computing on different CPU Kernels
-		std::vector<std::thread> threads;
+		ProfileScope scope("Input");
+		this->processInput(deltaTime);
+	}
 
-		for (int i = 0; i < 5; i++)
-		{
-			for (int j = 0; j < 5; j++)
-			{
-				auto threadFunc = [this, i, j]() {
-					this->updateInteraction(this->particles[i], this->particles[j], this->attraction[i][j]);
-				};
+	//GUI changes of the last frame go to the simulation thread, its newest frame comes back (never waits for a step)
+	this->simThread->runReplies();
+	this->simThread->setControls(this->controls, this->revision);
+	this->frame = &this->simThread->acquire();
 
-				threads.emplace_back(threadFunc);
-			}
-		}
-
-		//Wait until all threads are finished
-		for (auto& thread : threads)
-		{
-			thread.join();
-		}
-		//for (int i = 0; i < 5; i++)
-		//{
-		//	for (int j = 0; j < 5; j++)
-		//	{
-		//		this->updateInteraction(this->particles[i], this->particles[j], this->attraction[i][j]);
-		//	}
-		//}
+	//Replay: the decoding thread of the player dequantizes the positions
+	if (this->player.isOpen())
+	{
+		ProfileScope scope("Replay");
+		this->player.advance(deltaTime);
+		this->player.fetch(this->replayPositions);
+		InstanceSource source;
+		source.current = (const float*)this->replayPositions.data();
+		source.previous = NULL;
+		source.stride = 3;
+		source.alpha = 1.0f;
+		source.cubeSize = this->frame->settings.cubeSize;
+		source.colors = this->instanceColors.data();
+
+		//Nothing drawn until the first frame is decoded
+		source.count = this->player.getShownFrame() < 0 ? 0 : (int)this->replayPositions.size();
+		this->cullInstances(source);
+		return;
 	}
 
-	//Update all particles
-	for (int i = 0; i < this->particles.size(); i++)
+	//A command changed settings or particles
+	if (this->frame->revision != this->revision)
 	{
-		for (auto* particle : this->particles[i])
-		{
-			particle->update();
-		}
+		ProfileScope scope("Colors");
+		this->takeFrame(*this->frame);
 	}
 
-	//Update Particle Scale
-
-	if (this->particles.size() > 0) {
-		this->particles[0][0]->setScale(this->scale);
-	}
+	//Instances between the last two frames, interpolated by the render pool while culling and writing them into the ring
+	const std::vector<glm::vec4>& previous = this->simThread->getPrevious();
+	InstanceSource source;
+	source.current = (const float*)this->frame->positions.data();
+	source.previous = previous.size() == this->frame->positions.size() ? (const float*)previous.data() : NULL;
+	source.stride = 4;
+	source.alpha = this->interpolate ? this->simThread->getAlpha() : 1.0f;
+	source.cubeSize = this->frame->settings.cubeSize;
+	source.colors = this->instanceColors.data();
+	source.count = (int)this->frame->positions.size();
+	this->cullInstances(source);
 }
 
 void Simulation::render()
@@ -148,31 +221,46 @@ void Simulation::render()
 	//Bufferclear
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+	//Camera and light for all programs
+	this->uploadFrameUniforms();
+
 	//Render
 	this->DrawScene();
 
 	//Draw sun
 	if (this->shaderChoice == 0)
 	{
+		ProfileScope scope("Sun");
 		this->DrawSun();
 	}
 
 	if (this->skyBoxChoice != 0)
 	{
+		ProfileScope scope("SkyBox");
 		this->DrawSkyBox();
 	}
 
-	this->DrawScreen();
+	{
+		ProfileScope scope("PostProcessing");
+		this->DrawScreen();
+	}
 
 	if (this->showBorder)
 	{
+		ProfileScope scope("Border");
 		this->DrawCube();
 	}
 
 
-	this->DrawText();
+	{
+		ProfileScope scope("Text");
+		this->DrawText();
+	}
 
-	this->DrawSettings();
+	{
+		ProfileScope scope("ImGui");
+		this->DrawSettings();
+	}
 
 	ImGui::EndFrame();
 }
@@ -242,49 +330,41 @@ void Simulation::initBuffer()
 		std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << endl;
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-	//Instanced Rendering Buffer
-	glGenBuffers(1, &instanceVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
-	glBufferData(GL_ARRAY_BUFFER, 5 * this->amount * sizeof(glm::mat4), 0, GL_DYNAMIC_DRAW);
-
-	for (unsigned int i = 0; i < this->sphere->meshes.size(); i++)
-	{
-		unsigned int VAO = this->sphere->meshes[i].VAO;
-		glBindVertexArray(VAO);
-		//Every coloumn of the instance matrix gets its own Attribute Pointer
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)0);
-		glEnableVertexAttribArray(4);
-		glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4)));
-		glEnableVertexAttribArray(5);
-		glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(2 * sizeof(glm::vec4)));
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(3 * sizeof(glm::vec4)));
-
-		glVertexAttribDivisor(3, 1);
-		glVertexAttribDivisor(4, 1);
-		glVertexAttribDivisor(5, 1);
-		glVertexAttribDivisor(6, 1);
-
-		glBindVertexArray(0);
-	}
+	//Frame uniforms: one buffer for all programs, bound for the whole run
+	glGenBuffers(1, &this->frameUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, this->frameUBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORMS, this->frameUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-	//Color Buffer
-	glGenBuffers(1, &this->colorVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, this->colorVBO);
-	glBufferData(GL_ARRAY_BUFFER, this->colorData.size() * sizeof(glm::vec3), &this->colorData[0], GL_STATIC_DRAW);
+	//Instanced Rendering Buffer: 16 bytes per particle, position and packed color. The attributes point into the region of the frame (DrawScene)
+	this->instanceRing.init();
 
-	for (unsigned int i = 0; i < this->sphere->meshes.size(); i++)
+	Model* instanceModels[] = { this->sphere, this->lowPolySphere };
+	for (Model* model : instanceModels)
 	{
-		unsigned int VAO = this->sphere->meshes[i].VAO;
-		glBindVertexArray(VAO);
+		for (unsigned int i = 0; i < model->meshes.size(); i++)
+		{
+			unsigned int VAO = model->meshes[i].VAO;
+			glBindVertexArray(VAO);
 
-		glEnableVertexAttribArray(7);
-		glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
-		glVertexAttribDivisor(7, 1);
+			glEnableVertexAttribArray(3);
+			glEnableVertexAttribArray(4);
+			glVertexAttribDivisor(3, 1);
+			glVertexAttribDivisor(4, 1);
 
-		glBindVertexArray(0);
+			glBindVertexArray(0);
+		}
 	}
+
+	//Impostors: no vertex data, the corners of the quad come from gl_VertexID
+	glGenVertexArrays(1, &this->impostorVAO);
+	glBindVertexArray(this->impostorVAO);
+	glEnableVertexAttribArray(3);
+	glEnableVertexAttribArray(4);
+	glVertexAttribDivisor(3, 1);
+	glVertexAttribDivisor(4, 1);
+	glBindVertexArray(0);
 }
 
 void Simulation::initShader()
@@ -292,36 +372,84 @@ void Simulation::initShader()
 	//Create Shader objects for several shader units
 	this->screenShader = Shader("Shader/screen.vs", "Shader/screen.fs");
 	this->particleShader = Shader("Shader/particles.vs", "Shader/particles.fs");
+	this->impostorShader = Shader("Shader/impostor.vs", "Shader/particles.fs", nullptr, "#define IMPOSTOR\n");
 	this->cubeShader = Shader("Shader/cube.vs", "Shader/cube.fs");
 	this->sunShader = Shader("Shader/sun.vs", "Shader/sun.fs");
 	this->textShader = Shader("Shader/text.vs", "Shader/text.fs");
 	this->skyboxShader = Shader("Shader/cubemap.vs", "Shader/cubemap.fs");
+
+	//Camera and light of every program come from the buffer at FRAME_UNIFORMS
+	Shader* shaders[] = { &this->screenShader, &this->particleShader, &this->impostorShader, &this->cubeShader, &this->sunShader, &this->textShader, &this->skyboxShader };
+	for (Shader* shader : shaders)
+	{
+		shader->bindUniformBlock("Frame", FRAME_UNIFORMS);
+	}
+
+	//Color table for the types of the instances and uniforms that never change
+	Shader* instanceShaders[] = { &this->particleShader, &this->impostorShader };
+	for (int s = 0; s < 2; s++)
+	{
+		Shader* shader = instanceShaders[s];
+		InstanceUniforms& uniforms = this->instanceUniforms[s];
+		uniforms.scale = shader->getUniformLocation("scale");
+		uniforms.shaderChoice = shader->getUniformLocation("shaderChoice");
+		uniforms.sphereCenter = shader->getUniformLocation("sphereCenter");
+		uniforms.sphereRadius = shader->getUniformLocation("sphereRadius");
+		uniforms.meshScale = shader->getUniformLocation("meshScale");
+		uniforms.meshOffset = shader->getUniformLocation("meshOffset");
+
+		shader->use();
+		shader->setInt("shininess", 512);
+		shader->setInt("skybox", 0);
+		for (int i = 0; i < SimulationCore::MAX_TYPES; i++)
+		{
+			shader->setVec3("typeColors[" + std::to_string(i) + "]", this->typeColor(i));
+		}
+	}
+
+	this->screenShader.use();
+	this->screenShader.setInt("screenTexture", 0);
+	this->screenChoiceLocation = this->screenShader.getUniformLocation("choice");
+
+	//Text is drawn in window pixels, the projection never changes
+	this->textShader.use();
+	this->textShader.setMat4("projection", glm::ortho(0.0f, (float)this->WINDOW_WIDTH, 0.0f, (float)this->WINDOW_HEIGHT));
 }
 
 void Simulation::initVariables()
 {
-	//Settings
-	this->timeFactor = 0.7f;
+	//Settings (physics settings live in SimulationCore)
 	this->postProcessingChoice = 1;
 	this->shaderChoice = 6;
-	this->distanceMax = 150.0f;
 	this->scale = 0.5f;
-	this->cubeSize = 250.0f;
 	this->cameraSpeed = 600.0f;
 
+	//Threads (0 = all hardware threads)
+	this->threadCount = 0;
+	this->pinThreads = false;
+	this->renderPool = new ThreadPool(std::max(1, (int)std::thread::hardware_concurrency() / 4), false, "Render");
+
+	//Simulation thread
+	this->frame = NULL;
+	this->revision = -1;
+	this->typeCount = 0;
+	this->newTypeCount = 0;
+	this->interpolate = true;
+	this->controls.running = false;
+	this->impostors = false;
+	this->culling = true;
+	this->lodPixels[0] = 12.0f;
+	this->lodPixels[1] = 3.0f;
+
+	//Snapshots
+	this->controls.checkpointInterval = 0;
+
 	//Textrendering
-	this->textRenderer = new TextRenderer(10, this->WINDOW_WIDTH, this->WINDOW_HEIGHT);
+	this->textRenderer = new TextRenderer(10);
 	this->fontSize = 10;
 
-	//Friction @Tom Mohr
-	this->TIME_STEP = 0.2f;
-	this->frictionHalfLife = 0.04f;
-	this->friction = pow(0.5, this->TIME_STEP / this->frictionHalfLife);
-
 	//Settingbooleans
-	this->start = false;
 	this->showBorder = false;
-	this->borders = true;
 	this->viewMode = true; 
 
 	//Directional Light Shading 
@@ -329,7 +457,7 @@ void Simulation::initVariables()
 	this->dirLightDirection = glm::vec3(1.0, 1.0, 1.0);
 	this->angleHor = 0.0f;
 	this->angleVer = 1.0f;
-	this->dirLightPos = glm::vec3(this->dirLightDirection * this->cubeSize * 4.f);
+	this->dirLightPos = glm::vec3(this->dirLightDirection * 250.0f * 4.f);
 
 	//Projection matrices
 	this->projection = glm::mat4(1.0f);
@@ -342,6 +470,8 @@ void Simulation::initVariables()
 	this->randPosKeyPressed = false;
 	this->borderKeyPressed = false;
 	this->shadingTypeKeyPressed = false;
+	this->profilerKeyPressed = false;
+	this->traceKeyPressed = false;
 
 	//Skybox
 	this->oceanBox = new Skybox(this->ocean);
@@ -355,6 +485,15 @@ void Simulation::initModels()
 {
 	//Initialize Models
 	this->sphere = new Model(".\\resources\\models\\sphere\\sphere.obj");
+	this->lowPolySphere = new Model(".\\resources\\models\\lp_sphere\\lp_sphere.obj");
+
+	//Bounding sphere for the impostors and the culling (the mesh is not centered at the origin), the low poly sphere is fitted onto it
+	boundingSphere(this->sphere, this->sphereCenter, this->sphereRadius);
+	glm::vec3 lowPolyCenter;
+	float lowPolyRadius;
+	boundingSphere(this->lowPolySphere, lowPolyCenter, lowPolyRadius);
+	this->lowPolyScale = lowPolyRadius > 0.0f ? this->sphereRadius / lowPolyRadius : 1.0f;
+	this->lowPolyOffset = this->sphereCenter - lowPolyCenter * this->lowPolyScale;
 
 	this->borderBox = new ModelHandler(".\\resources\\models\\cube\\cube.obj");
 	this->sun = new ModelHandler(".\\resources\\models\\sphere\\sphere.obj");
@@ -362,12 +501,10 @@ void Simulation::initModels()
 
 void Simulation::initParticles()
 {
-	//Create Particles
-	this->red = this->create(amount, RED);
-	this->green = this->create(amount, GREEN);
-	this->blue = this->create(amount, BLUE);
-	this->yellow = this->create(amount, YELLOW);
-	this->white = this->create(amount, WHITE);
+	//Colors for the first frame of the simulation thread, the instances are built in update
+	this->randomColorsActive = false;
+	this->frame = &this->simThread->acquire();
+	this->takeFrame(*this->frame);
 }
 
 //Inputhandling------------------------------------------------------------------------------
@@ -414,7 +551,7 @@ void Simulation::processInput(float deltaTime)
 	}
 	if (glfwGetKey(this->window, GLFW_KEY_ENTER) == GLFW_PRESS && !this->startKeyPressed)
 	{
-		this->start = !this->start;
+		this->controls.running = !this->controls.running;
 		this->startKeyPressed = true;
 	}
 	if (glfwGetKey(this->window, GLFW_KEY_ENTER) == GLFW_RELEASE)
@@ -423,7 +560,9 @@ void Simulation::processInput(float deltaTime)
 	}
 	if (glfwGetKey(this->window, GLFW_KEY_R) == GLFW_PRESS && !this->randomKeyPressed)
 	{
-		this->randomAttraction();
+		this->post([](SimulationCore& core) {
+			core.randomAttraction();
+		});
 		this->randomKeyPressed = true;
 	}
 	if (glfwGetKey(this->window, GLFW_KEY_R) == GLFW_RELEASE)
@@ -433,7 +572,9 @@ void Simulation::processInput(float deltaTime)
 
 	if (glfwGetKey(this->window, GLFW_KEY_P) == GLFW_PRESS && !this->randPosKeyPressed)
 	{
-		this->randomPosition();
+		this->post([](SimulationCore& core) {
+			core.randomPosition();
+		});
 		this->randPosKeyPressed = true;
 	}
 	if (glfwGetKey(this->window, GLFW_KEY_P) == GLFW_RELEASE)
@@ -442,7 +583,7 @@ void Simulation::processInput(float deltaTime)
 	}
 	if (glfwGetKey(this->window, GLFW_KEY_B) == GLFW_PRESS && !this->borderKeyPressed)
 	{
-		this->borders = !this->borders;
+		this->nextBoundary();
 		this->borderKeyPressed = true;
 	}
 	if (glfwGetKey(this->window, GLFW_KEY_B) == GLFW_RELEASE)
@@ -458,6 +599,24 @@ void Simulation::processInput(float deltaTime)
 	{
 		this->shadingTypeKeyPressed = false;
 	}
+	if (glfwGetKey(this->window, GLFW_KEY_F2) == GLFW_PRESS && !this->profilerKeyPressed)
+	{
+		Profiler::setEnabled(!Profiler::isEnabled());
+		this->profilerKeyPressed = true;
+	}
+	if (glfwGetKey(this->window, GLFW_KEY_F2) == GLFW_RELEASE)
+	{
+		this->profilerKeyPressed = false;
+	}
+	if (glfwGetKey(this->window, GLFW_KEY_F3) == GLFW_PRESS && !this->traceKeyPressed)
+	{
+		Profiler::writeTrace("trace.json");
+		this->traceKeyPressed = true;
+	}
+	if (glfwGetKey(this->window, GLFW_KEY_F3) == GLFW_RELEASE)
+	{
+		this->traceKeyPressed = false;
+	}
 	if (glfwGetKey(this->window, GLFW_KEY_0) == GLFW_PRESS)
 	{
 		this->postProcessingChoice = 1;
@@ -503,224 +662,170 @@ void Simulation::processInput(float deltaTime)
 
 //Helper------------------------------------------------------------------------------
 
-std::vector<Life3D_Particles*> Simulation::create(int number, glm::vec3 color)
-{
-	//Create particles for a specific type at a random position inside the border box
-	std::vector<Life3D_Particles*> group;
-	for (int i = 0; i < number; i++)
-	{
-		int posX = random((int)this->cubeSize * 2, -(int)this->cubeSize);
-		int posY = random((int)this->cubeSize * 2, -(int)this->cubeSize);
-		int posZ = random((int)this->cubeSize * 2, -(int)this->cubeSize);
-		group.push_back(new Life3D_Particles(glm::vec3(posX, posY, posZ), color));
-
-		glm::mat4 model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(posX, posY, posZ));
-		model = glm::scale(model, glm::vec3(this->scale));
-		this->modelMatrices.push_back(model);
-		this->colorData.push_back(color);
-	}
-	this->particles.push_back(group);
-	return group;
-}
-
-int Simulation::random(int range, int start)
+void Simulation::takeFrame(const SimulationFrame& frame)
 {
-	return rand() % range + start;
-}
-
-float Simulation::force(float d, float a)
-{
-	//Force function to prevent particles from collapsing into singularity @Tom Mohr
-	const float beta = 0.3f;
-	if (d < beta)
+	//Controls as changed by the commands, particles may have been recreated
+	this->revision = frame.revision;
+	this->controls.settings = frame.settings;
+	this->controls.attraction = frame.attraction;
+	if (frame.typeCount != this->typeCount)
 	{
-		return d / beta - 1;
+		this->typeCount = frame.typeCount;
+		this->newTypeCount = frame.typeCount;
 	}
-	else if (beta < d && d < 1)
+
+	const int n = (int)frame.positions.size();
+	this->types.resize(n);
+	for (int i = 0; i < n; i++)
 	{
-		return a * (1 - abs(2 * d - 1 - beta) / (1 - beta));
-	}
-	else {
-		return 0.0f;
+		this->types[i] = (int)frame.positions[i].w;
 	}
+	this->fillColors();
 }
 
-void Simulation::randomPosition()
+void Simulation::uploadFrameUniforms()
 {
-	//sets all particles to a random position
-	int p = 0;
-	for (int i = 0; i < this->particles.size(); i++)
-	{
-		for (auto* particle : this->particles[i])
-		{
-			int posX = random((int)this->cubeSize * 2, -(int)this->cubeSize);
-			int posY = random((int)this->cubeSize * 2, -(int)this->cubeSize);
-			int posZ = random((int)this->cubeSize * 2, -(int)this->cubeSize);
-			particle->setPos(glm::vec3(posX, posY, posZ));
-			p++;
-		}
-	}
+	//The light direction follows the sun of the last frame (DrawSun)
+	FrameUniforms uniforms;
+	uniforms.projection = this->projection;
+	uniforms.view = this->view;
+	uniforms.viewPos = glm::vec4(this->camera.Position, 1.0f);
+	uniforms.dirLightDir = glm::vec4(-this->dirLightPos, 0.0f);
+	uniforms.dirLightColor = glm::vec4(this->dirLightColor.x, this->dirLightColor.y, this->dirLightColor.z, 1.0f);
+	uniforms.lightPos = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	uniforms.lightColor = BLACK;
+	uniforms.time = (float)glfwGetTime();
+
+	glBindBuffer(GL_UNIFORM_BUFFER, this->frameUBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &uniforms);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
-void Simulation::randomAttraction()
+void Simulation::cullInstances(const InstanceSource& source)
 {
-	//sets the attraction matrix to random values
-	for (int i = 0; i < 5; i++)
+	//Levels of detail by the projected radius of a particle in pixels, all impostors if selected
+	ProfileScope scope("Culling");
+	CullView view;
+	view.viewProjection = this->projection * this->view;
+	view.cameraPos = this->camera.Position;
+	view.center = this->sphereCenter * this->scale;
+	view.radius = this->sphereRadius * this->scale;
+	view.frustum = this->culling;
+	const float pixelsPerUnit = (float)this->WINDOW_HEIGHT * 0.5f / std::tan(glm::radians(this->camera.Zoom) * 0.5f);
+	for (int l = 0; l < LOD_LEVELS - 1; l++)
 	{
-		for (int j = 0; j < 5; j++) {
-			this->attraction[i][j] = (float)random(200, -100) / 100;
+		if (this->impostors)
+		{
+			view.lodDistance[l] = 0.0f;
+		}
+		else if (this->culling)
+		{
+			view.lodDistance[l] = view.radius * pixelsPerUnit / std::max(this->lodPixels[l], 0.1f);
+		}
+		else
+		{
+			view.lodDistance[l] = std::numeric_limits<float>::infinity();
 		}
 	}
-}
 
-//Updates------------------------------------------------------------------------------
+	//Cells of the neighbour grid, the visible instances go straight into the ring. The ring holds all instances,
+	//so the visible count changing with the camera never reallocates it
+	this->instanceRing.beginFrame();
+	this->instanceRing.reserve(source.count);
+	const int visible = this->culler.classify(source, view, this->frame->settings.distanceMax, this->renderPool);
+	ParticleInstance* instances = this->instanceRing.map(visible);
+	this->culler.compact(source, instances, this->renderPool);
+}
 
-void Simulation::updateInteraction(std::vector<Life3D_Particles*> particle1, std::vector<Life3D_Particles*> particle2, float attraction)
+void Simulation::post(const std::function<void(SimulationCore&)>& command)
 {
-	//Each particle receives a force vector from each other (That would be a perfect possibility to parallelize that on the GPU)
-	for (int i = 0; i < particle1.size(); i++)
-	{
-		float fx = 0;	//f hier gleichzusetzen mit a, da die Massen aller Teilchen 1 sind
-		float fy = 0;
-		float fz = 0;
-
-		//Calculation of the force vectors	
-		for (int j = 0; j < particle2.size(); j++)
-		{
-			float dx = particle2[j]->getPos().x - particle1[i]->getPos().x;
-			float dy = particle2[j]->getPos().y - particle1[i]->getPos().y;
-			float dz = particle2[j]->getPos().z - particle1[i]->getPos().z;
-			float distance = sqrt(dx * dx + dy * dy + dz * dz);
+	//Controls first, the command may start a new revision
+	this->simThread->setControls(this->controls, this->revision);
+	this->simThread->post(command);
+}
 
-			if (distance > 0 && distance < this->distanceMax)
-			{
-				const float f = this->force(distance / this->distanceMax, attraction);
+void Simulation::resetTypes(int count)
+{
+	//Recreates all particles for a new number of types, a recording only holds the old ones
+	this->simThread->stopRecording();
+	this->player.close();
+	this->randomColorsActive = false;
+	this->simThread->setSnapshotColors(std::vector<glm::vec3>());
+	this->post([count](SimulationCore& core) {
+		core.resetTypes(count);
+	});
+}
 
-				fx += f * dx / distance;
-				fy += f * dy / distance;
-				fz += f * dz / distance;
+void Simulation::saveSnapshot(const std::string& fileName)
+{
+	//Written on the simulation thread with the colors of setSnapshotColors
+	this->simThread->setControls(this->controls, this->revision);
+	this->simThread->saveSnapshot(fileName);
+}
 
-			}
-		}
+void Simulation::loadSnapshot(const std::string& fileName)
+{
+	//Loaded on the simulation thread, the random colors of the snapshot come back after a successful load
+	this->simThread->loadSnapshot(fileName, [this](const std::vector<float>& colors) {
+		this->player.close();
+		this->randomColors.assign((const glm::vec3*)colors.data(), (const glm::vec3*)colors.data() + colors.size() / 3);
+		this->randomColorsActive = !colors.empty();
+		this->revision = -1;
+	});
+}
 
-		fx *= this->distanceMax;
-		fy *= this->distanceMax;
-		fz *= this->distanceMax;
+void Simulation::startReplay(const std::string& fileName)
+{
+	//The simulation pauses, its particles come back with stopReplay
+	this->simThread->stopRecording();
+	if (!this->player.open(fileName, this->threadCount))
+	{
+		return;
+	}
+	this->controls.running = false;
 
-		//Update particle velocity and position
-		particle1[i]->setVel(glm::vec3(
-			particle1[i]->getVelocity().x * this->friction + fx * this->deltaTime * this->timeFactor,
-			particle1[i]->getVelocity().y * this->friction + fy * this->deltaTime * this->timeFactor,
-			particle1[i]->getVelocity().z * this->friction + fz * this->deltaTime * this->timeFactor
-		));
+	this->replayPositions.assign(this->player.getParticleCount(), glm::vec3(0.0f));
+	this->types = this->player.getTypes();
+	this->randomColorsActive = false;
+	this->fillColors();
+}
 
-		particle1[i]->setPos(glm::vec3(
-			particle1[i]->getPos() + particle1[i]->getVelocity() * this->deltaTime / ((float)this->amount / 1000) * this->timeFactor
-		));
+void Simulation::stopReplay()
+{
+	//Colors and buffers of the simulation frames again
+	this->player.close();
+	this->revision = -1;
+}
 
-		//Borders
-		this->updateBorders(particle1[i]);
+void Simulation::fillColors()
+{
+	//Instances of the simulation and of replays are in id order, type colors come from the table of the shader
+	const bool random = this->randomColorsActive && this->randomColors.size() == this->types.size();
+	this->instanceColors.resize(this->types.size());
+	for (int i = 0; i < (int)this->types.size(); i++)
+	{
+		this->instanceColors[i] = random ? packColor(this->randomColors[i]) : (unsigned int)this->types[i];
 	}
 }
 
-void Simulation::updateBorders(Life3D_Particles* particle)
+void Simulation::nextBoundary()
 {
-	//x -
-	if (this->borders)
-	{
-		if (particle->getPos().x <= -cubeSize)
-		{
-			particle->setVel(glm::vec3(
-				particle->getVelocity().x * -1,
-				particle->getVelocity().y,
-				particle->getVelocity().z
-			));
-
-			particle->setPos(glm::vec3(
-				-cubeSize + 1,
-				particle->getPos().y,
-				particle->getPos().z
-			));
-		}
-		//x +
-		if (particle->getPos().x >= cubeSize)
-		{
-			particle->setVel(glm::vec3(
-				particle->getVelocity().x * -1,
-				particle->getVelocity().y,
-				particle->getVelocity().z
-			));
-
-			particle->setPos(glm::vec3(
-				cubeSize - 5,
-				particle->getPos().y,
-				particle->getPos().z
-			));
-		}
+	this->controls.settings.boundary = (BoundaryMode)((this->controls.settings.boundary + 1) % 3);
+}
 
-		//y -
-		if (particle->getPos().y <= -cubeSize)
-		{
-			particle->setVel(glm::vec3(
-				particle->getVelocity().x,
-				particle->getVelocity().y * -1,
-				particle->getVelocity().z
-			));
-
-			particle->setPos(glm::vec3(
-				particle->getPos().x,
-				-cubeSize + 1,
-				particle->getPos().z
-			));
-		}
-		//y +
-		if (particle->getPos().y >= cubeSize)
-		{
-			particle->setVel(glm::vec3(
-				particle->getVelocity().x,
-				particle->getVelocity().y * -1,
-				particle->getVelocity().z
-			));
-
-			particle->setPos(glm::vec3(
-				particle->getPos().x,
-				cubeSize - 5,
-				particle->getPos().z
-			));
-		}
+glm::vec3 Simulation::typeColor(int type)
+{
+	return TYPE_COLORS[type % (sizeof(TYPE_COLORS) / sizeof(TYPE_COLORS[0]))];
+}
 
-		//z -
-		if (particle->getPos().z <= -cubeSize)
-		{
-			particle->setVel(glm::vec3(
-				particle->getVelocity().x,
-				particle->getVelocity().y,
-				particle->getVelocity().z * -1
-			));
-
-			particle->setPos(glm::vec3(
-				particle->getPos().x,
-				particle->getPos().y,
-				-cubeSize + 1
-			));
-		}
-		//z +
-		if (particle->getPos().z >= cubeSize)
-		{
-			particle->setVel(glm::vec3(
-				particle->getVelocity().x,
-				particle->getVelocity().y,
-				particle->getVelocity().z * -1
-			));
-
-			particle->setPos(glm::vec3(
-				particle->getPos().x,
-				particle->getPos().y,
-				cubeSize - 5
-			));
-		}
+std::string Simulation::typeName(int type)
+{
+	const char* names[] = { "Rot", "Gruen", "Blau", "Gelb", "Weiss" };
+	if (type < 5)
+	{
+		return names[type];
 	}
+	return "Typ " + std::to_string(type + 1);
 }
 
 //Rendering------------------------------------------------------------------------------
@@ -728,50 +833,71 @@ void Simulation::updateBorders(Life3D_Particles* particle)
 void Simulation::DrawScene()
 {
 
-	//Update uniforms in particleShader
-	this->particleShader.use();
-	this->particleShader.setMat4("projection", this->projection);
-	this->particleShader.setMat4("view", this->view);
-
-	this->particleShader.setVec3("dirLightColor", glm::vec3(this->dirLightColor.x, this->dirLightColor.y, this->dirLightColor.z));
-	this->particleShader.setVec3("dirLightDir", -this->dirLightPos);
-	this->particleShader.setVec3("lightColor", glm::vec3(BLACK));
-	this->particleShader.setVec3("lightPos", glm::vec3(0.0f, 0.0f, 0.0f));
-	this->particleShader.setVec3("viewPos", camera.Position);
+	//Update uniforms in the shaders of the particles, both share particles.fs (camera and light are in the frame uniforms)
+	Shader* instanceShaders[] = { &this->particleShader, &this->impostorShader };
+	for (int s = 0; s < 2; s++)
+	{
+		const InstanceUniforms& uniforms = this->instanceUniforms[s];
+		instanceShaders[s]->use();
+		instanceShaders[s]->setFloat(uniforms.scale, this->scale);
+		instanceShaders[s]->setInt(uniforms.shaderChoice, this->shaderChoice);
+		instanceShaders[s]->setVec3(uniforms.sphereCenter, this->sphereCenter);
+		instanceShaders[s]->setFloat(uniforms.sphereRadius, this->sphereRadius);
+	}
 
-	this->particleShader.setFloat("time", (float)glfwGetTime());
+	//Instances were written in update, no copy left here
+	{
+		ProfileScope scope("UploadInstances");
+		this->instanceRing.unmap();
+	}
 
-	this->particleShader.setInt("shininess", 512);
-	this->particleShader.setInt("shaderChoice", this->shaderChoice);
-	this->particleShader.setInt("skybox", 0);
+	//One draw per level of detail, the low poly sphere shares particles.vs with the sphere mesh
+	ProfileScope scope("DrawSpheres");
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+	this->particleShader.use();
+	this->particleShader.setFloat(this->instanceUniforms[0].meshScale, 1.0f);
+	this->particleShader.setVec3(this->instanceUniforms[0].meshOffset, glm::vec3(0.0f));
+	this->DrawInstances(this->sphere, LOD_SPHERE);
+	this->particleShader.setFloat(this->instanceUniforms[0].meshScale, this->lowPolyScale);
+	this->particleShader.setVec3(this->instanceUniforms[0].meshOffset, this->lowPolyOffset);
+	this->DrawInstances(this->lowPolySphere, LOD_LOW_POLY);
+	this->impostorShader.use();
+	this->DrawInstances(NULL, LOD_IMPOSTOR);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	this->instanceRing.fence();
 
+	glBindVertexArray(0);
+}
 
-	//Update instanced matrix (transformation matrix)
-	int k = 0;
-	for (int i = 0; i < this->particles.size(); i++)
+void Simulation::DrawInstances(Model* model, int level)
+{
+	const int count = this->culler.getCount(level);
+	if (count == 0)
 	{
-		for (auto* particle : this->particles[i])
-		{
-			this->modelMatrices[k] = particle->getModel();
-			k++;
-		}
+		return;
 	}
 
-	//Batchupdates for transformation matrices
-	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, 5 * this->amount * sizeof(glm::mat4), &modelMatrices[0]);
-
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-	for (unsigned int i = 0; i < this->sphere->meshes.size(); i++)
+	//Instances of the level within the region of the frame
+	const size_t offset = this->instanceRing.getOffset() + (size_t)this->culler.getFirst(level) * sizeof(ParticleInstance);
+	if (model == NULL)
 	{
-		glBindVertexArray(this->sphere->meshes[i].VAO);
-		glDrawElementsInstanced(GL_TRIANGLES, static_cast<unsigned int>(this->sphere->meshes[i].indices.size()), GL_UNSIGNED_INT, 0, 5 * this->amount);
+		//4 vertices per particle instead of the whole mesh
+		glBindVertexArray(this->impostorVAO);
+		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (void*)(offset + offsetof(ParticleInstance, position)));
+		glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(ParticleInstance), (void*)(offset + offsetof(ParticleInstance, color)));
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)count);
+		glBindVertexArray(0);
+		return;
+	}
+	for (unsigned int i = 0; i < model->meshes.size(); i++)
+	{
+		glBindVertexArray(model->meshes[i].VAO);
+		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (void*)(offset + offsetof(ParticleInstance, position)));
+		glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(ParticleInstance), (void*)(offset + offsetof(ParticleInstance, color)));
+		glDrawElementsInstanced(GL_TRIANGLES, static_cast<unsigned int>(model->meshes[i].indices.size()), GL_UNSIGNED_INT, 0, (GLsizei)count);
 		glBindVertexArray(0);
 	}
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-	glBindVertexArray(0);
 }
 
 void Simulation::DrawSettings()
@@ -794,35 +920,76 @@ void Simulation::DrawSettings()
 		//Settings
 		ImGui::Text("Settings");
 		ImGui::SetNextItemWidth((float)this->WINDOW_WIDTH / 5);
-		ImGui::SliderFloat("Timefactor", &this->timeFactor, 0.0f, 2.0f);
+		ImGui::SliderFloat("Timefactor", &this->controls.settings.timeFactor, 0.0f, 2.0f);
 		ImGui::SetNextItemWidth((float)this->WINDOW_WIDTH / 5);
-		ImGui::SliderFloat("Distance", &this->distanceMax, 0.0f, 700.0f);
+		ImGui::SliderFloat("Distance", &this->controls.settings.distanceMax, 0.0f, 700.0f);
 		ImGui::SetNextItemWidth((float)this->WINDOW_WIDTH / 5);
 		ImGui::SliderFloat("Scale", &this->scale, 0.00f, 2.0f);
 		ImGui::SetNextItemWidth((float)this->WINDOW_WIDTH / 5);
-		ImGui::SliderFloat("Boxsize", &this->cubeSize, 1.0f, 700.0f);
+		ImGui::SliderFloat("Boxsize", &this->controls.settings.cubeSize, 1.0f, 700.0f);
 		ImGui::SetNextItemWidth((float)this->WINDOW_WIDTH / 5);
 		ImGui::SliderFloat("Camspeed", &this->cameraSpeed, 1.0f, 1000.0f);
 
+		//Neighbour search
+		ImGui::Checkbox("Neighbour Lists", &this->controls.settings.neighbourLists);
+		ImGui::SameLine();
+		ImGui::Checkbox("Half Shell", &this->controls.settings.halfShell);
+		ImGui::SetNextItemWidth((float)this->WINDOW_WIDTH / 5);
+		ImGui::SliderFloat("Skin", &this->controls.settings.skin, 0.0f, 100.0f);
+		ImGui::SetNextItemWidth((float)this->WINDOW_WIDTH / 5);
+		ImGui::SliderInt("Reorder", &this->controls.settings.reorderInterval, 0, 1000);
+
+		//Force law: Formula -> Table Linear -> Table Cubic
+		std::string forceChoice = std::string("Force: ") + getForceLawName(this->controls.settings.forceLaw);
+		if (ImGui::Button(forceChoice.c_str()))
+		{
+			this->controls.settings.forceLaw = (ForceLaw)((this->controls.settings.forceLaw + 1) % 3);
+		}
+		ImGui::SetNextItemWidth((float)this->WINDOW_WIDTH / 5);
+		ImGui::SliderFloat("Beta", &this->controls.settings.beta, 0.05f, 0.95f);
+
+		//Simulation clock
+		ImGui::Checkbox("Fixed Timestep", &this->controls.fixedTimestep);
+		ImGui::SameLine();
+		ImGui::Checkbox("Interpolate", &this->interpolate);
+		float stepRate = 1.0f / this->controls.fixedStep;
+		ImGui::SetNextItemWidth((float)this->WINDOW_WIDTH / 5);
+		if (ImGui::SliderFloat("Steps/s", &stepRate, 10.0f, 240.0f, "%.0f"))
+		{
+			this->controls.fixedStep = 1.0f / stepRate;
+		}
+		ImGui::SetNextItemWidth((float)this->WINDOW_WIDTH / 5);
+		ImGui::SliderInt("Max Substeps", &this->controls.maxSubsteps, 1, 16);
+		float budgetMs = this->controls.budget * 1000.0f;
+		ImGui::SetNextItemWidth((float)this->WINDOW_WIDTH / 5);
+		if (ImGui::SliderFloat("Budget (ms)", &budgetMs, 1.0f, 50.0f, "%.1f"))
+		{
+			this->controls.budget = budgetMs / 1000.0f;
+		}
+
 		//Simulation control
 		if (ImGui::Button("Random")) {
-			this->randomAttraction();
+			this->post([](SimulationCore& core) {
+				core.randomAttraction();
+			});
 		}
 
 		const char* play = "Start";
-		if (this->start) {
+		if (this->controls.running) {
 			play = "Stopp";
 		}
 		ImGui::SameLine();
 		if (ImGui::Button(play))
 		{
-			this->start = !this->start;
+			this->controls.running = !this->controls.running;
 		}
 
 		ImGui::SameLine();
 		if (ImGui::Button("RandomPos"))
 		{
-			this->randomPosition();
+			this->post([](SimulationCore& core) {
+				core.randomPosition();
+			});
 		}
 
 		ImGui::SameLine();
@@ -836,12 +1003,77 @@ void Simulation::DrawSettings()
 		}
 		ImGui::SameLine();
 
-		const char* borderChoice = "Borders";
-		if (this->borders)
-			borderChoice = "No Borders";
-		if (ImGui::Button(borderChoice))
+		//Reflective -> Periodic -> None
+		std::string borderChoice = std::string("Border: ") + getBoundaryName(this->controls.settings.boundary);
+		if (ImGui::Button(borderChoice.c_str()))
 		{
-			this->borders = !this->borders;
+			this->nextBoundary();
+		}
+
+		//Snapshots
+		ImGui::Text("Snapshot");
+		if (ImGui::Button("Save"))
+		{
+			this->saveSnapshot("snapshot.l3ds");
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Load"))
+		{
+			this->loadSnapshot("snapshot.l3ds");
+		}
+		ImGui::SameLine();
+		if (ImGui::Button(this->frame->recording ? "Stop Recording" : "Record"))
+		{
+			if (this->frame->recording)
+			{
+				this->simThread->stopRecording();
+			}
+			else
+			{
+				this->simThread->startRecording("trajectory.l3dt");
+			}
+		}
+
+		//Replay of trajectory.l3dt
+		if (ImGui::Button(this->player.isOpen() ? "Stop Replay" : "Replay"))
+		{
+			if (this->player.isOpen())
+			{
+				this->stopReplay();
+			}
+			else
+			{
+				this->startReplay("trajectory.l3dt");
+			}
+		}
+		if (this->player.isOpen())
+		{
+			ImGui::SameLine();
+			if (ImGui::Button(this->player.playing ? "Pause" : "Play"))
+			{
+				if (!this->player.playing && this->player.getFrame() == this->player.getFrameCount() - 1)
+				{
+					this->player.seek(0);
+				}
+				this->player.playing = !this->player.playing;
+			}
+			int frame = this->player.getFrame();
+			ImGui::SetNextItemWidth((float)this->WINDOW_WIDTH / 5);
+			if (ImGui::SliderInt("Frame", &frame, 0, this->player.getFrameCount() - 1))
+			{
+				this->player.seek(frame);
+			}
+			ImGui::SetNextItemWidth((float)this->WINDOW_WIDTH / 5);
+			ImGui::SliderFloat("Frames/s", &this->player.speed, 1.0f, 240.0f);
+		}
+		ImGui::SetNextItemWidth((float)this->WINDOW_WIDTH / 5);
+		ImGui::SliderInt("Checkpoint", &this->controls.checkpointInterval, 0, 10000);
+
+		//Frame profiler overlay (F2)
+		bool profiling = Profiler::isEnabled();
+		if (ImGui::Checkbox("Profiler", &profiling))
+		{
+			Profiler::setEnabled(profiling);
 		}
 
 		//Postprocessing
@@ -933,6 +1165,10 @@ void Simulation::DrawSettings()
 		{
 			this->shaderChoice = 6;
 		}
+		ImGui::SameLine();
+		ImGui::Checkbox("Impostors", &this->impostors);
+		ImGui::Checkbox("Culling/LOD", &this->culling);
+		ImGui::SliderFloat2("LOD Pixels", this->lodPixels, 1.0f, 64.0f, "%.0f");
 		ImGui::Text("Colors");
 		if (ImGui::Button("RandomColors"))
 		{
@@ -941,68 +1177,113 @@ void Simulation::DrawSettings()
 			std::mt19937 gen(rd());
 			std::uniform_real_distribution<float> dis(0.0f, 1.0f);
 
-			glm::vec3* rColors = new glm::vec3[this->amount * 5];
-
-			for (int i = 0; i < this->amount * 5 - 1; i++) {
-				rColors[i] = glm::vec3(dis(gen), dis(gen), dis(gen));
+			//One color per particle id
+			this->randomColors.resize(this->types.size());
+			for (int i = 0; i < (int)this->randomColors.size(); i++) {
+				this->randomColors[i] = glm::vec3(dis(gen), dis(gen), dis(gen));
 			}
 
-			this->randomColors = new glm::vec3[this->amount * 5];
-			std::memcpy(this->randomColors, rColors, sizeof(glm::vec3) * (this->amount * 5));
-			delete[] rColors;
-
-			//Update colorVBO
-			glBindBuffer(GL_ARRAY_BUFFER, this->colorVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, 5 * amount * sizeof(glm::vec3), &this->randomColors[0]);
+			//Packed into the instances from the next frame on
+			this->randomColorsActive = true;
+			this->fillColors();
+			this->simThread->setSnapshotColors(this->randomColors);
 		}
 		ImGui::SameLine();
 		if (ImGui::Button("NormalColors"))
 		{
-			glBindBuffer(GL_ARRAY_BUFFER, this->colorVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, 5 * amount * sizeof(glm::vec3), &this->colorData[0]);
+			this->randomColorsActive = false;
+			this->fillColors();
+			this->simThread->setSnapshotColors(std::vector<glm::vec3>());
 		}
 
-		//Slider (kann man bestimmt schner mit Dictionarys lsen)
-		ImGui::Text("Rot");
-		ImGui::SliderFloat("rr", &this->attraction[0][0], -1.0f, 1.0f);
-		ImGui::SliderFloat("rg", &this->attraction[0][1], -1.0f, 1.0f);
-		ImGui::SliderFloat("rb", &this->attraction[0][2], -1.0f, 1.0f);
-		ImGui::SliderFloat("ry", &this->attraction[0][3], -1.0f, 1.0f);
-		ImGui::SliderFloat("rw", &this->attraction[0][4], -1.0f, 1.0f);
-
-		ImGui::Text("Gruen");
-		ImGui::SliderFloat("gr", &this->attraction[1][0], -1.0f, 1.0f);
-		ImGui::SliderFloat("gg", &this->attraction[1][1], -1.0f, 1.0f);
-		ImGui::SliderFloat("gb", &this->attraction[1][2], -1.0f, 1.0f);
-		ImGui::SliderFloat("gy", &this->attraction[1][3], -1.0f, 1.0f);
-		ImGui::SliderFloat("gw", &this->attraction[1][4], -1.0f, 1.0f);
-
-		ImGui::Text("Blau");
-		ImGui::SliderFloat("br", &this->attraction[2][0], -1.0f, 1.0f);
-		ImGui::SliderFloat("bg", &this->attraction[2][1], -1.0f, 1.0f);
-		ImGui::SliderFloat("bb", &this->attraction[2][2], -1.0f, 1.0f);
-		ImGui::SliderFloat("by", &this->attraction[2][3], -1.0f, 1.0f);
-		ImGui::SliderFloat("bw", &this->attraction[2][4], -1.0f, 1.0f);
-
-		ImGui::Text("Gelb");
-		ImGui::SliderFloat("yr", &this->attraction[3][0], -1.0f, 1.0f);
-		ImGui::SliderFloat("yg", &this->attraction[3][1], -1.0f, 1.0f);
-		ImGui::SliderFloat("yb", &this->attraction[3][2], -1.0f, 1.0f);
-		ImGui::SliderFloat("yy", &this->attraction[3][3], -1.0f, 1.0f);
-		ImGui::SliderFloat("yw", &this->attraction[3][4], -1.0f, 1.0f);
-
-		ImGui::Text("Weiss");
-		ImGui::SliderFloat("wr", &this->attraction[4][0], -1.0f, 1.0f);
-		ImGui::SliderFloat("wg", &this->attraction[4][1], -1.0f, 1.0f);
-		ImGui::SliderFloat("wb", &this->attraction[4][2], -1.0f, 1.0f);
-		ImGui::SliderFloat("wy", &this->attraction[4][3], -1.0f, 1.0f);
-		ImGui::SliderFloat("ww", &this->attraction[4][4], -1.0f, 1.0f);
+		//Types, Apply recreates all particles
+		ImGui::Text("Types");
+		ImGui::SetNextItemWidth((float)this->WINDOW_WIDTH / 5);
+		ImGui::SliderInt("Types", &this->newTypeCount, 1, SimulationCore::MAX_TYPES);
+		ImGui::SameLine();
+		if (ImGui::Button("Apply"))
+		{
+			this->resetTypes(this->newTypeCount);
+		}
+
+		//Attraction sliders, one block per type receiving the force
+		const int typeCount = this->typeCount;
+		float* attraction = &this->controls.attraction[0];
+		for (int i = 0; i < typeCount; i++)
+		{
+			ImGui::Text("%s", this->typeName(i).c_str());
+			for (int j = 0; j < typeCount; j++)
+			{
+				ImGui::PushID(i * typeCount + j);
+				ImGui::SliderFloat(this->typeName(j).c_str(), &attraction[i * typeCount + j], -1.0f, 1.0f);
+				ImGui::PopID();
+			}
+		}
 		ImGui::ColorPicker3("DirLight", (float*)&this->dirLightColor, ImGuiColorEditFlags_InputRGB);
 		ImGui::End();
+	}
+
+	//Shown in view mode as well
+	if (Profiler::isEnabled())
+	{
+		this->DrawProfiler();
+	}
+
+	ImGui::Render();
+	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+}
+
+void Simulation::DrawProfiler()
+{
+	ImGui::Begin("Profiler", NULL, ImGuiWindowFlags_NoMove);
+	ImGui::SetWindowPos(ImVec2((float)this->WINDOW_WIDTH * 0.6f, 50));
+	ImGui::SetWindowSize(ImVec2((float)this->WINDOW_WIDTH * 0.4f - 5, (float)this->WINDOW_HEIGHT * 0.6f), ImGuiCond_FirstUseEver);
+
+	//CPU time per frame, GL calls only count their submission
+	std::vector<float> frameTimes = Profiler::getFrameTimes();
+	if (!frameTimes.empty())
+	{
+		std::string overlay = "Frame: " + std::to_string(frameTimes.back()) + " ms";
+		ImGui::PlotLines("##Frames", frameTimes.data(), (int)frameTimes.size(), 0, overlay.c_str(), 0.0f, FLT_MAX, ImVec2(ImGui::GetContentRegionAvail().x, 60));
+	}
+	if (ImGui::Button("Write Trace"))
+	{
+		Profiler::writeTrace("trace.json");
+	}
+	ImGui::SameLine();
+	ImGui::Text("trace.json, last %d frames (F3)", Profiler::TRACE_FRAMES);
 
-		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+	//Milliseconds per frame over the last HISTORY frames, phases that ran several times per frame are added up
+	ImGui::Text("ms per frame over %d frames", Profiler::HISTORY);
+	if (ImGui::BeginTable("Phases", 7, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_ScrollY))
+	{
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("Thread");
+		ImGui::TableSetupColumn("Phase");
+		ImGui::TableSetupColumn("Mean");
+		ImGui::TableSetupColumn("p50");
+		ImGui::TableSetupColumn("p95");
+		ImGui::TableSetupColumn("p99");
+		ImGui::TableSetupColumn("Max");
+		ImGui::TableHeadersRow();
+		std::vector<ProfileStats> stats = Profiler::getStats();
+		for (const ProfileStats& stat : stats)
+		{
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(stat.thread.c_str());
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(stat.name.c_str());
+			const double values[] = { stat.mean, stat.p50, stat.p95, stat.p99, stat.max };
+			for (double value : values)
+			{
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", value);
+			}
+		}
+		ImGui::EndTable();
 	}
+	ImGui::End();
 }
 
 void Simulation::DrawScreen()
@@ -1013,8 +1294,7 @@ void Simulation::DrawScreen()
 	glClear(GL_COLOR_BUFFER_BIT);
 
 	this->screenShader.use();
-	this->screenShader.setInt("screenTexture", 0);
-	this->screenShader.setInt("choice", this->postProcessingChoice);
+	this->screenShader.setInt(this->screenChoiceLocation, this->postProcessingChoice);
 
 	glActiveTexture(GL_TEXTURE0);
 	glBindVertexArray(this->screenVAO);
@@ -1025,10 +1305,10 @@ void Simulation::DrawScreen()
 
 void Simulation::DrawCube()
 {
-	float scaleFactor = this->cubeSize;
+	float scaleFactor = this->controls.settings.cubeSize;
 	this->borderBox->Translate(glm::vec3(1.0f));
 	this->borderBox->Scale(scaleFactor);
-	this->borderBox->Draw(&this->cubeShader, this->projection, this->view, BLUE_GREEN);
+	this->borderBox->Draw(&this->cubeShader, BLUE_GREEN);
 }
 
 void Simulation::DrawSkyBox()
@@ -1053,7 +1333,7 @@ void Simulation::DrawSkyBox()
 
 void Simulation::DrawSun()
 {
-	float lichtBahnRadius = this->cubeSize * 4.f;
+	float lichtBahnRadius = this->controls.settings.cubeSize * 4.f;
 	float sinAngleHor = sin(angleHor);
 	float cosAngleHor = cos(angleHor);
 	float sinAngleVer = sin(angleVer);
@@ -1068,7 +1348,7 @@ void Simulation::DrawSun()
 
 	this->sun->Translate(this->dirLightPos);
 	this->sun->Scale(40.0f);
-	this->sun->Draw(&this->sunShader, this->projection, this->view, glm::vec3(this->dirLightColor.x, this->dirLightColor.y, this->dirLightColor.z));
+	this->sun->Draw(&this->sunShader, glm::vec3(this->dirLightColor.x, this->dirLightColor.y, this->dirLightColor.z));
 }
 
 void Simulation::DrawText()
@@ -1077,13 +1357,20 @@ void Simulation::DrawText()
 	this->textRenderer->Draw(this->textShader, "Pos: " + std::to_string(this->camera.Position.x) + ", " + std::to_string(this->camera.Position.y) + ", " + std::to_string(this->camera.Position.z), 0.0f, (float)this->WINDOW_HEIGHT - 2 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
 	this->textRenderer->Draw(this->textShader, "CameraView: " + std::to_string(this->camera.Front.x) + ", " + std::to_string(this->camera.Front.y) + ", " + std::to_string(this->camera.Front.z), 0.0f, (float)this->WINDOW_HEIGHT - 3 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
 	this->textRenderer->Draw(this->textShader, "DeltaTime: " + std::to_string(this->deltaTime), 0.0f, (float)this->WINDOW_HEIGHT - 4 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
-
-	this->textRenderer->Draw(this->textShader, "Start: " + std::to_string(this->start), this->WINDOW_WIDTH / 2, (float)this->WINDOW_HEIGHT - 1 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
-	this->textRenderer->Draw(this->textShader, "Borders: " + std::to_string(this->borders), this->WINDOW_WIDTH / 2, (float)this->WINDOW_HEIGHT - 2 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
+	std::string upload = "Instances: " + std::to_string(this->instanceRing.getUploadedBytes() / 1024) + " KB/frame, fence wait " + std::to_string(this->instanceRing.getFenceWait()) + " ms"
+		+ (this->instanceRing.isPersistent() ? " (persistent)" : " (orphaning)");
+	this->textRenderer->Draw(this->textShader, upload, 0.0f, (float)this->WINDOW_HEIGHT - 5 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
+	const int triangles = this->culler.getCount(LOD_SPHERE) * triangleCount(this->sphere) + this->culler.getCount(LOD_LOW_POLY) * triangleCount(this->lowPolySphere) + this->culler.getCount(LOD_IMPOSTOR) * 2;
+	std::string culled = this->culling ? "Culling: " + std::to_string(this->culler.getVisibleCells()) + "/" + std::to_string(this->culler.getCells()) + " cells, " + std::to_string(this->culler.getCulled()) + " culled" : "Culling: off";
+	this->textRenderer->Draw(this->textShader, culled + ", LOD " + std::to_string(this->culler.getCount(LOD_SPHERE)) + "/" + std::to_string(this->culler.getCount(LOD_LOW_POLY)) + "/" + std::to_string(this->culler.getCount(LOD_IMPOSTOR))
+		+ ", " + std::to_string(triangles) + " triangles", 0.0f, (float)this->WINDOW_HEIGHT - 6 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
+
+	this->textRenderer->Draw(this->textShader, "Start: " + std::to_string(this->controls.running), this->WINDOW_WIDTH / 2, (float)this->WINDOW_HEIGHT - 1 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
+	this->textRenderer->Draw(this->textShader, "Border: " + std::string(getBoundaryName(this->controls.settings.boundary)), this->WINDOW_WIDTH / 2, (float)this->WINDOW_HEIGHT - 2 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
 	
 	std::string shading[] = { "DirLightShading", "ReflectionShading", "OctreeShading", "GradientShading", "TimeGradientShading", "LayerShading", "NormalShading"};
-	this->textRenderer->Draw(this->textShader, "Shading: " + shading[this->shaderChoice], this->WINDOW_WIDTH / 2, (float)this->WINDOW_HEIGHT - 3 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
-	this->textRenderer->Draw(this->textShader, "Amount Particles: " + std::to_string(this->amount * 5), this->WINDOW_WIDTH / 2, (float)this->WINDOW_HEIGHT - 4 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
+	this->textRenderer->Draw(this->textShader, "Shading: " + shading[this->shaderChoice] + (this->impostors ? " (Impostors)" : ""), this->WINDOW_WIDTH / 2, (float)this->WINDOW_HEIGHT - 3 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
+	this->textRenderer->Draw(this->textShader, "Amount Particles: " + std::to_string(this->frame->positions.size()) + " (" + std::to_string(this->frame->typeCount) + " Types)", this->WINDOW_WIDTH / 2, (float)this->WINDOW_HEIGHT - 4 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
 	
 	std::string postprocessing[] = { "Sharpness", "Normal", "Edge Detection", "Inversion", "Grayscale"};
 	this->textRenderer->Draw(this->textShader, "Postprocessing: " + postprocessing[this->postProcessingChoice], this->WINDOW_WIDTH / 2, (float)this->WINDOW_HEIGHT - 5 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
@@ -1091,4 +1378,25 @@ void Simulation::DrawText()
 	std::string skyboxes[] = { "None", "Ocean", "Space", "Forest", "City" };
 	this->textRenderer->Draw(this->textShader, "Skybox: " + skyboxes[this->skyBoxChoice], this->WINDOW_WIDTH / 2, (float)this->WINDOW_HEIGHT - 6 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
 
+	this->textRenderer->Draw(this->textShader, "SIMD: " + std::string(getSimdName(this->frame->simdLevel)) + ", Threads: " + std::to_string(this->frame->threadCount), this->WINDOW_WIDTH / 2, (float)this->WINDOW_HEIGHT - 7 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
+	this->textRenderer->Draw(this->textShader, "Substeps: " + std::to_string(this->frame->substeps) + ", Sim speed: " + std::to_string((int)(this->frame->simSpeed * 100.0f + 0.5f)) + "%, Step: " + std::to_string(this->frame->stepCost * 1000.0f) + " ms", this->WINDOW_WIDTH / 2, (float)this->WINDOW_HEIGHT - 8 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
+
+	NeighbourListStats stats = this->frame->neighbourStats;
+	std::string lists = stats.active ? "Neighbour lists: " + std::to_string((int)stats.averageLength) + " per particle, rebuild every " + std::to_string((int)stats.rebuildInterval) + " steps" : "Neighbour lists: off";
+	this->textRenderer->Draw(this->textShader, lists, this->WINDOW_WIDTH / 2, (float)this->WINDOW_HEIGHT - 9 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
+
+	if (this->player.isOpen())
+	{
+		std::string replay = "Replay: frame " + std::to_string(this->player.getShownFrame()) + " / " + std::to_string(this->player.getFrameCount() - 1)
+			+ ", step " + std::to_string(this->player.getShownStep()) + ", " + std::to_string(this->player.getParticleCount()) + " particles";
+		this->textRenderer->Draw(this->textShader, replay, this->WINDOW_WIDTH / 2, (float)this->WINDOW_HEIGHT - 10 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
+	}
+	if (this->frame->recording)
+	{
+		RecorderStats recorded = this->frame->recorderStats;
+		std::string recording = "Recording: " + std::to_string(recorded.frames) + " frames (" + std::to_string(recorded.dropped) + " dropped), "
+			+ std::to_string((int)(recorded.ratio + 0.5)) + ":1, " + std::to_string(recorded.bytesPerSecond / 1048576.0) + " MB/s";
+		this->textRenderer->Draw(this->textShader, recording, this->WINDOW_WIDTH / 2, (float)this->WINDOW_HEIGHT - 10 * (float)this->fontSize, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
+	}
+
 }
@@ -20,13 +20,33 @@
 #include <ModelLoader/model.h>
 #include <SkyBox/Skybox.h>
 
-#include "Life3D_Particles.h"
+#include "SimulationCore.h"
+#include "SimulationThread.h"
+#include "InstanceRing.h"
+#include "InstanceCuller.h"
+#include "TrajectoryPlayer.h"
+#include "Profiler.h"
 #include "TextRenderer.h"
 #include "ModelHandler.h"
+
+//Mirror of the std140 uniform block Frame of the shaders: vec3 members take 16 bytes, a float after a vec3 fills its last 4
+struct FrameUniforms
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec4 viewPos;
+	glm::vec4 dirLightDir;
+	glm::vec4 dirLightColor;
+	glm::vec4 lightPos;
+	glm::vec3 lightColor;
+	float time;
+};
+
 class Simulation
 {
 public:
-	Simulation(GLFWwindow* window, int WINDOW_WIDTH, int WINDOW_HEIGHT, int amount);
+	Simulation(GLFWwindow* window, int WINDOW_WIDTH, int WINDOW_HEIGHT, int amount, int typeCount);
+	~Simulation();
 
 	void update(float deltaTime, int FPS, Camera camera);
 	void render();
@@ -46,33 +66,65 @@ private:
 
 	//Shader
 	Shader particleShader;
+	Shader impostorShader;
 	Shader screenShader;
 	Shader cubeShader;
 	Shader sunShader;
 	Shader textShader;
 	Shader skyboxShader;
 
+	//Locations of the uniforms set every frame, kept once after linking (particleShader, impostorShader)
+	struct InstanceUniforms
+	{
+		int scale;
+		int shaderChoice;
+		int sphereCenter;
+		int sphereRadius;
+		int meshScale;
+		int meshOffset;
+	};
+	InstanceUniforms instanceUniforms[2];
+	int screenChoiceLocation; //screenShader
+
 	//Matrizen
 	glm::mat4 projection;
 	glm::mat4 view;
 
-	float attraction[5][5];
+	//Uniform buffer of the Frame block, written once per frame and bound to every program
+	unsigned int frameUBO;
+	static const unsigned int FRAME_UNIFORMS = 0; //Binding point
 
-	std::vector<glm::mat4> modelMatrices;
-	std::vector<glm::vec3> colorData;
-	glm::vec3* randomColors;
+	InstanceCuller culler;
+	InstanceRing instanceRing;                //Visible instances level by level, written by the render pool straight into GPU memory
+	bool culling;                             //Off: every particle is drawn with the sphere mesh (or as impostor)
+	float lodPixels[LOD_LEVELS - 1];          //Projected radius below which a particle gets the next coarser level
+	std::vector<unsigned int> instanceColors; //Packed colors of the instances (type or RGB8)
+	std::vector<glm::vec3> replayPositions;   //Fetched from the player
+	std::vector<glm::vec3> randomColors;  //Indexed by particle id
+	bool randomColorsActive;
+	std::vector<int> types;               //Indexed by particle id
 
 	//TIMING
 	float deltaTime;
 	float FPS;
 
-	//Particles
-	std::vector<Life3D_Particles*> red;
-	std::vector<Life3D_Particles*> yellow;
-	std::vector<Life3D_Particles*> green;
-	std::vector<Life3D_Particles*> blue;
-	std::vector<Life3D_Particles*> white;
-	std::vector<std::vector<Life3D_Particles*>> particles;
+	//Particles, forces and integration run on the simulation thread (it owns the core, snapshots and recordings),
+	//the render thread draws the newest frame it published
+	SimulationThread* simThread;
+	const SimulationFrame* frame; //Acquired in update
+	SimulationControls controls;  //Edited by the GUI, handed to the simulation thread every frame
+	int revision;                 //Of the frame controls, colors and buffers were taken from, -1 = take the next one
+	int typeCount;
+	int newTypeCount;
+	bool interpolate;             //Between the last two frames, drawn one publish interval behind the simulation
+	ThreadPool* renderPool;       //Instance matrices, the workers of the core belong to the simulation thread
+
+	//Replay of a recorded trajectory instead of the simulation while open
+	TrajectoryPlayer player;
+
+	//Multithreading
+	int threadCount;
+	bool pinThreads;
 
 	glm::vec3 dirLightDirection;
 	glm::vec3 dirLightPos;
@@ -81,6 +133,13 @@ private:
 
 	//World objects
 	Model* sphere;
+	glm::vec3 sphereCenter; //Bounding sphere of the sphere mesh, impostors are ray-cast against it
+	float sphereRadius;
+	bool impostors;         //Particles as one quad each instead of a sphere mesh
+	unsigned int impostorVAO;
+	Model* lowPolySphere;   //Level of detail between sphere and impostor
+	glm::vec3 lowPolyOffset; //Fits the low poly sphere onto the bounding sphere of the sphere mesh
+	float lowPolyScale;
 
 	ModelHandler* borderBox;
 	ModelHandler* sun;
@@ -130,26 +189,16 @@ private:
 			"resources\\textures\\skybox\\city_2_back.jpg"
 	};
 
-	//Friction
-	float TIME_STEP;
-	float friction;
-	float frictionHalfLife;
-
 	//Settings
 	int amount;
 	int postProcessingChoice;
 	int shaderChoice;
 
-	float timeFactor;
-	float distanceMax;
-	float cubeSize;
 	float scale;
 	float cameraSpeed;
 
 	bool viewMode;
-	bool start;
 	bool showBorder;
-	bool borders;
 
 	ImVec4 dirLightColor;
 
@@ -159,6 +208,8 @@ private:
 	bool randPosKeyPressed;
 	bool borderKeyPressed;
 	bool shadingTypeKeyPressed;
+	bool profilerKeyPressed;
+	bool traceKeyPressed;
 
 	//Framebuffer
 	unsigned int screenVAO;
@@ -167,8 +218,6 @@ private:
 	unsigned int texColorBuffer;
 	unsigned int rbo;
 
-	unsigned int instanceVBO;
-	unsigned int colorVBO;
 
 	float* quadVertices;
 
@@ -187,25 +236,30 @@ private:
 
 	//Helper------------------------------------------------------------------------------
 
-	std::vector<Life3D_Particles*> create(int number, glm::vec3 color);
-	int random(int range, int start);
-	float force(float d, float a);
-	void randomPosition();
-	void randomAttraction();
-
-	//Updates------------------------------------------------------------------------------
-
-	void updateInteraction(std::vector<Life3D_Particles*> particle1, std::vector<Life3D_Particles*>particle2, float attraction);
-	void updateBorders(Life3D_Particles* particle);
+	void takeFrame(const SimulationFrame& frame);
+	void uploadFrameUniforms();
+	void cullInstances(const InstanceSource& source);
+	void post(const std::function<void(SimulationCore&)>& command);
+	void resetTypes(int count);
+	void saveSnapshot(const std::string& fileName);
+	void loadSnapshot(const std::string& fileName);
+	void startReplay(const std::string& fileName);
+	void stopReplay();
+	void fillColors();
+	void nextBoundary();
+	glm::vec3 typeColor(int type);
+	std::string typeName(int type);
 
 	//Rendering------------------------------------------------------------------------------
 
 	void DrawScene();
+	void DrawInstances(Model* model, int level);
 	void DrawSettings();
 	void DrawScreen();
 	void DrawCube();
 	void DrawSkyBox();
 	void DrawSun();
 	void DrawText();
+	void DrawProfiler();
 };
 
@@ -0,0 +1,99 @@
+#include "SimulationClock.h"
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+SimulationClock::SimulationClock(float fixedStep, int maxSubsteps, float budget)
+{
+	this->fixedTimestep = true;
+	this->fixedStep = fixedStep;
+	this->maxSubsteps = maxSubsteps;
+	this->budget = budget;
+
+	this->accumulator = 0.0f;
+	this->substeps = 0;
+	this->simSpeed = 1.0f;
+	this->stepCost = 0.0f;
+}
+
+int SimulationClock::advance(float frameTime, const std::function<void(float)>& step)
+{
+	frameTime = std::min(std::max(frameTime, 0.0f), MAX_FRAME_TIME);
+	const int maxSubsteps = std::max(1, this->maxSubsteps);
+
+	//Variable step: one step with the frame time, clamped to what the fixed mode would allow at most
+	if (!this->fixedTimestep)
+	{
+		float dt = std::min(frameTime, this->fixedStep * maxSubsteps);
+		step(dt);
+		this->accumulator = 0.0f;
+		this->substeps = 1;
+		this->smoothSimSpeed(frameTime > 0.0f ? dt / frameTime : 1.0f);
+		return 1;
+	}
+
+	this->accumulator += frameTime;
+
+	std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+	int count = 0;
+	while (this->accumulator >= this->fixedStep && count < maxSubsteps)
+	{
+		//Stop when the next step would exceed the budget, at least one step per frame keeps the simulation moving
+		float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - frameStart).count();
+		if (count > 0 && elapsed + this->stepCost > this->budget)
+		{
+			break;
+		}
+
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		step(this->fixedStep);
+		float cost = std::chrono::duration<float>(std::chrono::steady_clock::now() - t0).count();
+		this->stepCost = this->stepCost == 0.0f ? cost : this->stepCost * 0.9f + cost * 0.1f;
+
+		this->accumulator -= this->fixedStep;
+		count++;
+	}
+
+	//Drop the time that could not be simulated this frame, the partial step stays for the next one
+	if (this->accumulator >= this->fixedStep)
+	{
+		this->accumulator = std::fmod(this->accumulator, this->fixedStep);
+	}
+
+	this->substeps = count;
+	this->smoothSimSpeed(frameTime > 0.0f ? count * this->fixedStep / frameTime : 1.0f);
+	return count;
+}
+
+void SimulationClock::reset()
+{
+	this->accumulator = 0.0f;
+	this->substeps = 0;
+	this->simSpeed = 1.0f;
+}
+
+float SimulationClock::getAlpha()
+{
+	return this->fixedTimestep ? this->accumulator / this->fixedStep : 0.0f;
+}
+
+int SimulationClock::getSubsteps()
+{
+	return this->substeps;
+}
+
+float SimulationClock::getSimSpeed()
+{
+	return this->simSpeed;
+}
+
+float SimulationClock::getStepCost()
+{
+	return this->stepCost;
+}
+
+void SimulationClock::smoothSimSpeed(float speed)
+{
+	//A single frame only does whole steps, averaging gives a readable value
+	this->simSpeed = this->simSpeed * 0.95f + speed * 0.05f;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <functional>
+
+//Decouples simulation steps from the render rate: frame time is collected in an accumulator and consumed in fixed steps.
+//Under load the number of substeps and their wall time per frame are capped, the rest is dropped so the simulation slows down instead of spiralling.
+class SimulationClock
+{
+public:
+	SimulationClock(float fixedStep = 1.0f / 60.0f, int maxSubsteps = 4, float budget = 0.010f);
+
+	//Runs step(dt) as often as due for this frame, returns the number of steps
+	int advance(float frameTime, const std::function<void(float)>& step);
+	void reset();
+
+	//Fraction of a step left in the accumulator [0, 1), for interpolating between the last two states
+	float getAlpha();
+	int getSubsteps();
+	//Simulated time / real time of the last frame (1 = real time)
+	float getSimSpeed();
+	//Wall time of one step, smoothed
+	float getStepCost();
+
+	//Settings
+	bool fixedTimestep;
+	float fixedStep;
+	int maxSubsteps;
+	float budget;
+
+	//Frame times above this are treated as a hitch (debugger, window drag)
+	static constexpr float MAX_FRAME_TIME = 0.25f;
+
+private:
+	float accumulator;
+	int substeps;
+	float simSpeed;
+	float stepCost;
+
+	void smoothSimSpeed(float speed);
+};
+
@@ -0,0 +1,601 @@
+#include "SimulationCore.h"
+#include "Profiler.h"
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+
+static inline void reflect(float& pos, float& vel, float cubeSize)
+{
+	//Mirror the part that went through the wall, clamp in case it went through the whole box
+	if (pos < -cubeSize)
+	{
+		pos = std::min(-2.0f * cubeSize - pos, cubeSize);
+		vel = -vel;
+	}
+	else if (pos > cubeSize)
+	{
+		pos = std::max(2.0f * cubeSize - pos, -cubeSize);
+		vel = -vel;
+	}
+}
+
+static inline void wrap(float& pos, float cubeSize)
+{
+	//Into [-cubeSize, cubeSize)
+	if (pos < -cubeSize || pos >= cubeSize)
+	{
+		float boxSize = 2.0f * cubeSize;
+		pos -= boxSize * std::floor((pos + cubeSize) / boxSize);
+		if (pos >= cubeSize)
+		{
+			pos = -cubeSize;
+		}
+	}
+}
+
+//Border policies of the integration
+struct ReflectiveBorder
+{
+	static inline void apply(BoundaryMode mode, float& pos, float& vel, float cubeSize) { reflect(pos, vel, cubeSize); }
+};
+
+struct PeriodicBorder
+{
+	static inline void apply(BoundaryMode mode, float& pos, float& vel, float cubeSize) { wrap(pos, cubeSize); }
+};
+
+struct OpenBorder
+{
+	static inline void apply(BoundaryMode mode, float& pos, float& vel, float cubeSize) {}
+};
+
+//Generic path: the mode is checked for every particle
+struct RuntimeBorder
+{
+	static inline void apply(BoundaryMode mode, float& pos, float& vel, float cubeSize)
+	{
+		switch (mode)
+		{
+		case BOUNDARY_REFLECTIVE:
+			reflect(pos, vel, cubeSize);
+			break;
+		case BOUNDARY_PERIODIC:
+			wrap(pos, cubeSize);
+			break;
+		default:
+			break;
+		}
+	}
+};
+
+const char* getBoundaryName(BoundaryMode mode)
+{
+	switch (mode)
+	{
+	case BOUNDARY_PERIODIC:
+		return "Periodic";
+	case BOUNDARY_NONE:
+		return "None";
+	default:
+		return "Reflective";
+	}
+}
+
+const char* getForceLawName(ForceLaw law)
+{
+	switch (law)
+	{
+	case FORCE_TABLE_LINEAR:
+		return "Table Linear";
+	case FORCE_TABLE_CUBIC:
+		return "Table Cubic";
+	default:
+		return "Formula";
+	}
+}
+
+SimulationCore::SimulationCore(int amount, int typeCount, int threadCount, bool pinThreads)
+{
+	this->amount = std::max(0, amount);
+	this->typeCount = std::max(1, std::min(typeCount, (int)MAX_TYPES));
+
+	this->initVariables();
+	this->threadPool = new ThreadPool(threadCount, pinThreads);
+	this->initParticles();
+	this->randomAttraction();
+}
+
+SimulationCore::~SimulationCore()
+{
+	delete this->threadPool;
+}
+
+static inline long long nanoseconds(std::chrono::steady_clock::time_point time)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+void SimulationCore::step(float deltaTime)
+{
+	this->deltaTime = deltaTime;
+	this->stepCount++;
+
+	const int n = this->particles.size();
+	const int grain = std::max(64, n / (this->threadPool->getThreadCount() * 4));
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+	//Neighbours in space become neighbours in memory
+	bool reordered = false;
+	if (this->settings.reorderInterval > 0 && ++this->stepsSinceReorder >= this->settings.reorderInterval)
+	{
+		this->reorderParticles();
+		reordered = true;
+	}
+	std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+	//Grid and neighbour lists (only rebuilt if needed)
+	this->updateNeighbours(grain);
+
+	//Kernel input for this step
+	this->kernelArgs.x = this->grid.getSortedX();
+	this->kernelArgs.y = this->grid.getSortedY();
+	this->kernelArgs.z = this->grid.getSortedZ();
+	this->kernelArgs.type = this->grid.getSortedType();
+	this->kernelArgs.sortedIndex = this->grid.getSortedIndex();
+	this->kernelArgs.bucketStart = this->grid.getBucketStart();
+	this->kernelArgs.cellsPerAxis = this->grid.getCellsPerAxis();
+	this->kernelArgs.cubeSize = this->grid.getCubeSize();
+	this->kernelArgs.invCellSize = this->grid.getInvCellSize();
+	this->kernelArgs.period = this->getPeriod();
+	this->kernelArgs.neighbourStart = this->neighbourList.isValid() ? this->neighbourList.getStart() : NULL;
+	this->kernelArgs.neighbours = this->neighbourList.getNeighbours();
+	this->kernelArgs.neighbourTypes = this->neighbourList.getNeighbourTypes();
+	this->kernelArgs.attraction = this->attraction.data();
+	this->kernelArgs.attractionTransposed = this->attractionTransposed.data();
+	this->kernelArgs.typeCount = this->typeCount;
+	this->kernelArgs.distanceMax = this->settings.distanceMax;
+	this->kernelArgs.forceLaw = this->settings.forceLaw;
+	this->kernelArgs.beta = this->settings.beta;
+	if (this->settings.forceLaw != FORCE_FORMULA)
+	{
+		//Only rebuilt if the matrix, beta or the curves changed
+		this->forceTable.update(this->attraction.data(), this->typeCount, this->settings.beta, this->settings.forceLaw == FORCE_TABLE_CUBIC);
+		this->kernelArgs.forceTable = this->forceTable.getTable();
+		this->kernelArgs.forceTableTransposed = this->forceTable.getTransposed();
+	}
+	this->kernelArgs.forceX = this->particles.forceX.data();
+	this->kernelArgs.forceY = this->particles.forceY.data();
+	this->kernelArgs.forceZ = this->particles.forceZ.data();
+	this->selectVariants();
+	std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+
+	//Phase 1: forces from the frozen current state (in grid order), every particle only writes its own force
+	if (this->usePairKernel())
+	{
+		//Both sides of a pair at once, the workers write into their own accumulators which are summed up afterwards
+		for (int i = 0; i < this->typeCount; i++)
+		{
+			for (int j = 0; j < this->typeCount; j++)
+			{
+				this->attractionTransposed[j * this->typeCount + i] = this->attraction[i * this->typeCount + j];
+			}
+		}
+		this->pairStride = n + SpatialGrid::PADDING;
+		const size_t size = (size_t)this->threadPool->getThreadCount() * 3 * this->pairStride;
+		if (this->pairForces.size() != size)
+		{
+			this->pairForces.assign(size, 0.0f);
+		}
+		this->threadPool->parallelFor(0, n, grain, [this](int begin, int end, int worker) {
+			this->updatePairInteraction(begin, end, worker);
+		});
+		this->threadPool->parallelFor(0, n, grain, [this](int begin, int end, int worker) {
+			this->reducePairForces(begin, end);
+		});
+	}
+	else
+	{
+		this->threadPool->parallelFor(0, n, grain, [this](int begin, int end, int worker) {
+			this->updateInteraction(begin, end);
+		});
+	}
+	std::chrono::steady_clock::time_point t3 = std::chrono::steady_clock::now();
+
+	this->integrateStep(deltaTime);
+	std::chrono::steady_clock::time_point t4 = std::chrono::steady_clock::now();
+
+	this->timings.reorder = std::chrono::duration<double>(t1 - t0).count();
+	this->timings.neighbours = std::chrono::duration<double>(t2 - t1).count();
+	this->timings.interaction = std::chrono::duration<double>(t3 - t2).count();
+	this->timings.integration = std::chrono::duration<double>(t4 - t3).count();
+
+	//Same clock readings for the frame profiler
+	if (Profiler::isEnabled())
+	{
+		if (reordered)
+		{
+			Profiler::record("Reorder", nanoseconds(t0), nanoseconds(t1));
+		}
+		Profiler::record("Neighbours", nanoseconds(t1), nanoseconds(t2));
+		Profiler::record("Interaction", nanoseconds(t2), nanoseconds(t3));
+		Profiler::record("Integration", nanoseconds(t3), nanoseconds(t4));
+	}
+}
+
+void SimulationCore::integrateStep(float deltaTime)
+{
+	//Phase 2: integration and borders write the next state, which then becomes the current one
+	this->deltaTime = deltaTime;
+	//Damping per simulated second stays the same for every step rate and frame time
+	this->friction = std::pow(0.5f, deltaTime * this->settings.timeFactor / this->settings.frictionHalfLife);
+	this->selectIntegration();
+	const int n = this->particles.size();
+	const int grain = std::max(64, n / (this->threadPool->getThreadCount() * 4));
+	this->threadPool->parallelFor(0, n, grain, [this](int begin, int end, int worker) {
+		(this->*(this->integrate))(begin, end);
+	});
+	this->particles.swap();
+}
+
+void SimulationCore::randomPosition()
+{
+	//sets all particles to a random position
+	for (int i = 0; i < this->particles.size(); i++)
+	{
+		int posX = random((int)this->settings.cubeSize * 2, -(int)this->settings.cubeSize);
+		int posY = random((int)this->settings.cubeSize * 2, -(int)this->settings.cubeSize);
+		int posZ = random((int)this->settings.cubeSize * 2, -(int)this->settings.cubeSize);
+		this->particles.setPos(i, glm::vec3(posX, posY, posZ));
+	}
+}
+
+void SimulationCore::randomAttraction()
+{
+	//sets the attraction matrix to random values
+	for (int i = 0; i < this->typeCount; i++)
+	{
+		for (int j = 0; j < this->typeCount; j++) {
+			this->attraction[i * this->typeCount + j] = (float)random(200, -100) / 100;
+		}
+	}
+}
+
+void SimulationCore::resetTypes(int count)
+{
+	//Recreates all particles for a new number of types
+	this->typeCount = std::max(1, std::min(count, (int)MAX_TYPES));
+	this->neighbourList.invalidate();
+	this->stepsSinceReorder = 0;
+	this->particles.clear();
+	this->initParticles();
+	this->randomAttraction();
+}
+
+void SimulationCore::resize(int amount, int typeCount)
+{
+	this->amount = std::max(0, amount);
+	this->typeCount = std::max(1, std::min(typeCount, (int)MAX_TYPES));
+	this->neighbourList.invalidate();
+	this->stepsSinceReorder = 0;
+	this->reorderCount++;
+	this->stepCount = 0;
+	this->particles.resize(this->amount * this->typeCount);
+	this->attraction.assign(this->typeCount * this->typeCount + ForceKernelArgs::ROW_PADDING, 0.0f);
+	this->attractionTransposed.assign(this->typeCount * this->typeCount + ForceKernelArgs::ROW_PADDING, 0.0f);
+}
+
+Life3D_Particles& SimulationCore::getParticles()
+{
+	return this->particles;
+}
+
+ThreadPool* SimulationCore::getThreadPool()
+{
+	return this->threadPool;
+}
+
+SimdLevel SimulationCore::getSimdLevel()
+{
+	return this->simdLevel;
+}
+
+NeighbourListStats SimulationCore::getNeighbourStats()
+{
+	return this->neighbourList.getStats();
+}
+
+StepTimings SimulationCore::getStepTimings()
+{
+	return this->timings;
+}
+
+int SimulationCore::getReorderCount()
+{
+	return this->reorderCount;
+}
+
+int SimulationCore::getStepCount()
+{
+	return this->stepCount;
+}
+
+void SimulationCore::setStepCount(int step)
+{
+	this->stepCount = step;
+}
+
+int SimulationCore::getAmount()
+{
+	return this->amount;
+}
+
+int SimulationCore::getTypeCount()
+{
+	return this->typeCount;
+}
+
+float SimulationCore::getAttraction(int type1, int type2)
+{
+	return this->attraction[type1 * this->typeCount + type2];
+}
+
+float* SimulationCore::getAttractionData()
+{
+	return this->attraction.data();
+}
+
+void SimulationCore::setAttraction(int type1, int type2, float value)
+{
+	this->attraction[type1 * this->typeCount + type2] = value;
+}
+
+void SimulationCore::setForceCurve(int type1, int type2, const std::vector<float>& values)
+{
+	this->forceTable.setCurve(type1, type2, values);
+}
+
+void SimulationCore::clearForceCurves()
+{
+	this->forceTable.clearCurves();
+}
+
+//Inits------------------------------------------------------------------------------
+
+void SimulationCore::initVariables()
+{
+	//Settings
+	this->settings.timeFactor = 0.7f;
+	this->settings.distanceMax = 150.0f;
+	this->settings.cubeSize = 250.0f;
+	this->settings.boundary = BOUNDARY_REFLECTIVE;
+	this->settings.forceLaw = FORCE_FORMULA;
+	this->settings.beta = 0.3f;
+	this->settings.neighbourLists = true;
+	this->settings.skin = 15.0f;
+	this->settings.halfShell = true;
+	this->settings.reorderInterval = 100;
+	this->settings.specializedKernels = true;
+
+	//Friction @Tom Mohr: at 60 steps/s and time factor 0.7 a step halves the velocity 5 times
+	this->settings.frictionHalfLife = 0.7f / 60.0f / 5.0f;
+
+	//SIMD
+	this->simdLevel = detectSimdLevel();
+	this->forceKernel = NULL;
+	this->pairKernel = NULL;
+	this->integrate = NULL;
+
+	this->kernelArgs.forceTable = NULL;
+	this->kernelArgs.forceTableTransposed = NULL;
+
+	this->deltaTime = 0.0f;
+	this->friction = 1.0f;
+	this->timings = StepTimings();
+	this->pairStride = 0;
+	this->stepsSinceReorder = 0;
+	this->reorderCount = 0;
+	this->stepCount = 0;
+}
+
+void SimulationCore::initParticles()
+{
+	//Create particles for every type at a random position inside the border box, type i starts at [i * amount, (i + 1) * amount) until the first reorder
+	for (int type = 0; type < this->typeCount; type++)
+	{
+		for (int i = 0; i < this->amount; i++)
+		{
+			int posX = random((int)this->settings.cubeSize * 2, -(int)this->settings.cubeSize);
+			int posY = random((int)this->settings.cubeSize * 2, -(int)this->settings.cubeSize);
+			int posZ = random((int)this->settings.cubeSize * 2, -(int)this->settings.cubeSize);
+			this->particles.add(glm::vec3(posX, posY, posZ), type);
+		}
+	}
+	this->attraction.assign(this->typeCount * this->typeCount + ForceKernelArgs::ROW_PADDING, 0.0f);
+	this->attractionTransposed.assign(this->typeCount * this->typeCount + ForceKernelArgs::ROW_PADDING, 0.0f);
+}
+
+//Helper------------------------------------------------------------------------------
+
+int SimulationCore::random(int range, int start)
+{
+	return rand() % range + start;
+}
+
+//Updates------------------------------------------------------------------------------
+
+void SimulationCore::reorderParticles()
+{
+	this->mortonOrder.compute(this->particles, this->settings.cubeSize, this->threadPool);
+	this->particles.reorder(this->mortonOrder.getOrder());
+
+	//Valid lists keep their grid order, only the particle indices behind it change
+	if (this->neighbourList.isValid())
+	{
+		const int* inverse = this->mortonOrder.getInverse();
+		this->threadPool->parallelFor(0, this->particles.size(), 4096, [this, inverse](int begin, int end, int worker) {
+			this->grid.remap(inverse, begin, end);
+		});
+		this->neighbourList.reorder(this->mortonOrder.getOrder());
+	}
+	else
+	{
+		this->neighbourList.invalidate();
+	}
+	this->stepsSinceReorder = 0;
+	this->reorderCount++;
+}
+
+void SimulationCore::updateNeighbours(int grain)
+{
+	const float cubeSize = this->settings.cubeSize;
+	const float distanceMax = this->settings.distanceMax;
+
+	if (!this->settings.neighbourLists)
+	{
+		//Bucket particles into cells with an edge of at least distanceMax
+		this->neighbourList.invalidate();
+		this->grid.build(this->particles, this->typeCount, cubeSize, distanceMax);
+		return;
+	}
+
+	//Lists cover distanceMax + skin, so they stay correct until some particle moved skin / 2
+	const float skin = std::max(0.0f, this->settings.skin);
+	const float cutoff = distanceMax + skin;
+	const float period = this->getPeriod();
+	if (this->neighbourList.needsRebuild(this->particles, cutoff, cubeSize, period, skin, this->threadPool))
+	{
+		this->grid.build(this->particles, this->typeCount, cubeSize, cutoff);
+		if (!this->neighbourList.build(this->grid, this->particles, cutoff, cubeSize, period, this->threadPool))
+		{
+			//Too many pairs for the lists, search the cells (built for distanceMax)
+			this->grid.build(this->particles, this->typeCount, cubeSize, distanceMax);
+		}
+	}
+	else if (this->neighbourList.isValid())
+	{
+		//Same order as at the build, only the positions move
+		this->threadPool->parallelFor(0, this->particles.size(), grain, [this](int begin, int end, int worker) {
+			this->grid.refresh(this->particles, begin, end);
+		});
+	}
+	else
+	{
+		this->grid.build(this->particles, this->typeCount, cubeSize, distanceMax);
+	}
+	this->neighbourList.countStep();
+}
+
+void SimulationCore::updateInteraction(int begin, int end)
+{
+	//Each particle receives a force vector from each other inside distanceMax, 4/8/16 neighbours per instruction
+	this->forceKernel(this->kernelArgs, begin, end);
+}
+
+void SimulationCore::updatePairInteraction(int begin, int end, int worker)
+{
+	float* acc = &this->pairForces[(size_t)worker * 3 * this->pairStride];
+	this->pairKernel(this->kernelArgs, begin, end, acc, acc + this->pairStride, acc + 2 * this->pairStride);
+}
+
+void SimulationCore::reducePairForces(int begin, int end)
+{
+	//Sum over the workers in grid order, scatter to particle order
+	const int stride = this->pairStride;
+	const int workers = this->threadPool->getThreadCount();
+	const int* sortedIndex = this->grid.getSortedIndex();
+	const float distanceMax = this->settings.distanceMax;
+
+	for (int k = begin; k < end; k++)
+	{
+		float fx = 0.0f;
+		float fy = 0.0f;
+		float fz = 0.0f;
+		for (int w = 0; w < workers; w++)
+		{
+			float* acc = &this->pairForces[(size_t)w * 3 * stride];
+			fx += acc[k];
+			fy += acc[k + stride];
+			fz += acc[k + 2 * stride];
+			acc[k] = 0.0f;
+			acc[k + stride] = 0.0f;
+			acc[k + 2 * stride] = 0.0f;
+		}
+		const int p = sortedIndex[k];
+		this->particles.forceX[p] = fx * distanceMax;
+		this->particles.forceY[p] = fy * distanceMax;
+		this->particles.forceZ[p] = fz * distanceMax;
+	}
+}
+
+template <class Border>
+void SimulationCore::updatePositions(int begin, int end)
+{
+	//Simulated time of the step, for velocity, position and friction alike
+	const float dt = this->deltaTime * this->settings.timeFactor;
+	const float friction = this->friction;
+	const float cubeSize = this->settings.cubeSize;
+	const BoundaryMode mode = this->settings.boundary;
+
+	Life3D_Particles& p = this->particles;
+	for (int i = begin; i < end; i++)
+	{
+		//Update particle velocity and position
+		p.nextVelX[i] = p.velX[i] * friction + p.forceX[i] * dt;
+		p.nextVelY[i] = p.velY[i] * friction + p.forceY[i] * dt;
+		p.nextVelZ[i] = p.velZ[i] * friction + p.forceZ[i] * dt;
+
+		p.nextPosX[i] = p.posX[i] + p.nextVelX[i] * dt;
+		p.nextPosY[i] = p.posY[i] + p.nextVelY[i] * dt;
+		p.nextPosZ[i] = p.posZ[i] + p.nextVelZ[i] * dt;
+
+		//Borders
+		Border::apply(mode, p.nextPosX[i], p.nextVelX[i], cubeSize);
+		Border::apply(mode, p.nextPosY[i], p.nextVelY[i], cubeSize);
+		Border::apply(mode, p.nextPosZ[i], p.nextVelZ[i], cubeSize);
+	}
+}
+
+void SimulationCore::selectVariants()
+{
+	//One dispatch per step instead of checks per particle and pair
+	const bool generic = !this->settings.specializedKernels;
+	this->forceKernel = getForceKernel(this->simdLevel, this->kernelArgs, generic);
+	this->pairKernel = getPairKernel(this->simdLevel, this->kernelArgs, generic);
+}
+
+void SimulationCore::selectIntegration()
+{
+	if (!this->settings.specializedKernels)
+	{
+		this->integrate = &SimulationCore::updatePositions<RuntimeBorder>;
+		return;
+	}
+	switch (this->settings.boundary)
+	{
+	case BOUNDARY_REFLECTIVE:
+		this->integrate = &SimulationCore::updatePositions<ReflectiveBorder>;
+		break;
+	case BOUNDARY_PERIODIC:
+		this->integrate = &SimulationCore::updatePositions<PeriodicBorder>;
+		break;
+	default:
+		this->integrate = &SimulationCore::updatePositions<OpenBorder>;
+		break;
+	}
+}
+
+bool SimulationCore::usePairKernel()
+{
+	//Lists stay full: gathering and scattering both sides of a listed pair costs more than the second distance.
+	//A periodic half shell needs distinct forward and backward cells.
+	if (!this->settings.halfShell || this->kernelArgs.neighbourStart)
+	{
+		return false;
+	}
+	return this->kernelArgs.period == 0.0f || this->kernelArgs.cellsPerAxis >= 3;
+}
+
+float SimulationCore::getPeriod()
+{
+	return this->settings.boundary == BOUNDARY_PERIODIC ? 2.0f * this->settings.cubeSize : 0.0f;
+}
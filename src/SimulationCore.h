@@ -0,0 +1,165 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "Life3D_Particles.h"
+#include "SpatialGrid.h"
+#include "NeighbourList.h"
+#include "MortonOrder.h"
+#include "ForceTable.h"
+#include "ThreadPool.h"
+#include "ForceKernel.h"
+
+//What happens at the faces of the box
+enum BoundaryMode
+{
+	BOUNDARY_REFLECTIVE, //Walls, velocity is mirrored
+	BOUNDARY_PERIODIC,   //Positions wrap around, distances use the nearest copy (minimum image)
+	BOUNDARY_NONE        //Particles may leave the box
+};
+
+const char* getBoundaryName(BoundaryMode mode);
+const char* getForceLawName(ForceLaw law);
+
+//Physics settings, may be changed between two steps (GUI sliders point directly at them)
+struct SimulationSettings
+{
+	float timeFactor;
+	float distanceMax;
+	float cubeSize;
+	BoundaryMode boundary;
+
+	//Formula or tables (own curves per type pair need a table), beta = end of the repulsion
+	ForceLaw forceLaw;
+	float beta;
+
+	//Verlet lists, rebuilt when a particle moved more than skin / 2
+	bool neighbourLists;
+	float skin;
+	//Cell search visits every pair only once (half shell), its distance serves both particles
+	bool halfShell;
+
+	//Steps between two Morton reorders of the particle arrays, 0 = never
+	int reorderInterval;
+
+	//Kernels and integration compiled for the current boundary, force law and type count, false = generic path with runtime checks
+	bool specializedKernels;
+
+	//Friction @Tom Mohr: simulated seconds until friction halves the velocity, the factor per step follows from the step time
+	float frictionHalfLife;
+};
+
+//Wall time of the phases of the last step in seconds
+struct StepTimings
+{
+	double reorder;
+	double neighbours;  //Grid, neighbour lists and kernel selection
+	double interaction; //Forces
+	double integration; //Velocities, positions and borders
+};
+
+//Simulation state and step function without any GLFW/OpenGL dependency, shared by the renderer and the headless runner
+class SimulationCore
+{
+public:
+	SimulationCore(int amount, int typeCount, int threadCount = 0, bool pinThreads = false);
+	~SimulationCore();
+
+	void step(float deltaTime);
+	//Second phase of step alone: integration and borders with the current forces
+	void integrateStep(float deltaTime);
+
+	void randomPosition();
+	void randomAttraction();
+	void resetTypes(int count);
+	//Room for amount particles per type and a zero matrix, the particle values are filled in by Snapshot::load
+	void resize(int amount, int typeCount);
+
+	Life3D_Particles& getParticles();
+	ThreadPool* getThreadPool();
+	SimdLevel getSimdLevel();
+	NeighbourListStats getNeighbourStats();
+	StepTimings getStepTimings();
+	int getReorderCount(); //Changes whenever the particle indices were permuted (ids stay)
+	int getStepCount();
+	void setStepCount(int step);
+	int getAmount();
+	int getTypeCount();
+	float getAttraction(int type1, int type2);
+	float* getAttractionData();
+	void setAttraction(int type1, int type2, float value);
+	//Own force curve of a type pair, values equally spaced over [0, distanceMax] (see ForceTable)
+	void setForceCurve(int type1, int type2, const std::vector<float>& values);
+	void clearForceCurves();
+
+	SimulationSettings settings;
+
+	static const int MAX_TYPES = 32;
+
+private:
+	//Particles
+	Life3D_Particles particles;
+	int amount;
+	int typeCount;
+	int stepCount;
+
+	//typeCount * typeCount, row = type receiving the force
+	std::vector<float> attraction;
+	std::vector<float> attractionTransposed;
+
+	//Sampled forces for the table force laws
+	ForceTable forceTable;
+
+	//Neighbour search
+	SpatialGrid grid;
+	NeighbourList neighbourList;
+
+	//Spatial order of the particle arrays
+	MortonOrder mortonOrder;
+	int stepsSinceReorder;
+	int reorderCount;
+
+	//Multithreading
+	ThreadPool* threadPool;
+
+	//Force kernel for the best instruction set of this CPU, variants picked at the start of every step
+	SimdLevel simdLevel;
+	ForceKernelFunc forceKernel;
+	PairKernelFunc pairKernel;
+	void (SimulationCore::*integrate)(int begin, int end);
+	ForceKernelArgs kernelArgs;
+
+	//Pair kernel: x, y, z force accumulators (grid order, padded) per worker, zeroed again by the reduction
+	std::vector<float> pairForces;
+	int pairStride;
+
+	float deltaTime;
+	float friction; //Velocity factor of the current step, from deltaTime and settings.frictionHalfLife
+	StepTimings timings;
+
+	//Inits------------------------------------------------------------------------------
+
+	void initVariables();
+	void initParticles();
+
+	//Helper------------------------------------------------------------------------------
+
+	int random(int range, int start);
+
+	//Updates------------------------------------------------------------------------------
+
+	void reorderParticles();
+	void updateNeighbours(int grain);
+	void updateInteraction(int begin, int end);
+	void updatePairInteraction(int begin, int end, int worker);
+	void reducePairForces(int begin, int end);
+	bool usePairKernel();
+	void selectVariants();
+	void selectIntegration();
+	template <class Border>
+	void updatePositions(int begin, int end);
+	float getPeriod();
+};
+
@@ -0,0 +1,304 @@
+#include "SimulationThread.h"
+#include "Profiler.h"
+#include <algorithm>
+
+SimulationThread::SimulationThread(SimulationCore* core, const SimulationControls& controls)
+{
+	this->core = core;
+	this->controls = controls;
+	this->revision = 0;
+	this->lastCapture = -1;
+	this->lastCheckpoint = core->getStepCount();
+	this->applyControls();
+
+	this->back = 0;
+	this->middle = 1;
+	this->front = 2;
+	this->previousTime = std::chrono::steady_clock::now();
+	this->previousRevision = -1;
+	this->pendingRevision = 0;
+	this->controlsChanged = false;
+	this->stop = false;
+
+	//The render thread has a frame from the start
+	this->publish();
+	this->thread = std::thread(&SimulationThread::threadLoop, this);
+}
+
+SimulationThread::~SimulationThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stop = true;
+	}
+	this->wakeCondition.notify_one();
+	this->thread.join();
+	this->recorder.close();
+	delete this->core;
+}
+
+//Render thread------------------------------------------------------------------------------
+
+const SimulationFrame& SimulationThread::acquire()
+{
+	if (this->middle.load(std::memory_order_acquire) & FRESH)
+	{
+		//The frame shown so far becomes the previous one, its buffer goes back to the simulation thread
+		SimulationFrame& shown = this->frames[this->front];
+		std::swap(this->previous, shown.positions);
+		this->previousTime = shown.time;
+		this->previousRevision = shown.revision;
+		this->front = this->middle.exchange(this->front, std::memory_order_acq_rel) & SLOT_MASK;
+	}
+	return this->frames[this->front];
+}
+
+const std::vector<glm::vec4>& SimulationThread::getPrevious()
+{
+	return this->previous;
+}
+
+float SimulationThread::getAlpha()
+{
+	const SimulationFrame& current = this->frames[this->front];
+	const float interval = std::chrono::duration<float>(current.time - this->previousTime).count();
+	if (this->previousRevision != current.revision || this->previous.size() != current.positions.size()
+		|| interval <= 0.0f || interval > SimulationClock::MAX_FRAME_TIME)
+	{
+		return 1.0f;
+	}
+	const float age = std::chrono::duration<float>(std::chrono::steady_clock::now() - current.time).count();
+	return std::min(1.0f, age / interval);
+}
+
+void SimulationThread::setControls(const SimulationControls& controls, int revision)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->pendingControls = controls;
+		this->pendingRevision = revision;
+		this->controlsChanged = true;
+	}
+	this->wakeCondition.notify_one();
+}
+
+void SimulationThread::post(const std::function<void(SimulationCore&)>& command)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->commands.push_back(command);
+	}
+	this->wakeCondition.notify_one();
+}
+
+void SimulationThread::runReplies()
+{
+	std::vector<std::function<void()>> replies;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		replies.swap(this->replies);
+	}
+	for (const std::function<void()>& callback : replies)
+	{
+		callback();
+	}
+}
+
+void SimulationThread::setSnapshotColors(const std::vector<glm::vec3>& colors)
+{
+	this->post([this, colors](SimulationCore& core) {
+		this->snapshotColors = colors;
+	});
+}
+
+void SimulationThread::saveSnapshot(const std::string& fileName)
+{
+	this->post([this, fileName](SimulationCore& core) {
+		//Random colors are part of the snapshot, type colors follow from the types
+		const bool colors = (int)this->snapshotColors.size() == core.getParticles().size();
+		Snapshot::save(fileName, core, colors ? (const float*)&this->snapshotColors[0] : NULL);
+	});
+}
+
+void SimulationThread::loadSnapshot(const std::string& fileName, const std::function<void(const std::vector<float>&)>& loaded)
+{
+	this->post([this, fileName, loaded](SimulationCore& core) {
+		//A recording only holds the particles of its start
+		this->recorder.close();
+		std::vector<float> colors;
+		if (!Snapshot::load(fileName, core, &colors))
+		{
+			return;
+		}
+		this->snapshotColors.assign((const glm::vec3*)colors.data(), (const glm::vec3*)colors.data() + colors.size() / 3);
+		this->reply([loaded, colors]() {
+			loaded(colors);
+		});
+	});
+}
+
+void SimulationThread::startRecording(const std::string& fileName)
+{
+	this->post([this, fileName](SimulationCore& core) {
+		if (this->recorder.open(fileName, core))
+		{
+			this->lastCapture = -1;
+		}
+	});
+}
+
+void SimulationThread::stopRecording()
+{
+	this->post([this](SimulationCore& core) {
+		this->recorder.close();
+	});
+}
+
+//Simulation thread------------------------------------------------------------------------------
+
+void SimulationThread::threadLoop()
+{
+	Profiler::setThreadName("Simulation");
+	std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+	std::chrono::duration<float> wait(0.0f);
+	while (true)
+	{
+		std::vector<std::function<void(SimulationCore&)>> commands;
+		{
+			//Sleeps while paused or until the next fixed step is due, controls, commands and stop wake it up early
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->wakeCondition.wait_for(lock, wait, [this] { return this->stop || this->controlsChanged || !this->commands.empty(); });
+			if (this->stop)
+			{
+				return;
+			}
+			if (this->controlsChanged && this->pendingRevision == this->revision)
+			{
+				this->controls = this->pendingControls;
+			}
+			this->controlsChanged = false;
+			commands.swap(this->commands);
+		}
+		this->applyControls();
+
+		if (!commands.empty())
+		{
+			ProfileScope scope("Commands");
+			for (const std::function<void(SimulationCore&)>& command : commands)
+			{
+				command(*this->core);
+			}
+			this->revision++;
+			this->lastCheckpoint = this->core->getStepCount();
+		}
+
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		const float elapsed = std::chrono::duration<float>(now - last).count();
+		last = now;
+		int steps = 0;
+		if (this->controls.running)
+		{
+			//Fixed steps from the elapsed time, capped by substeps and time budget
+			steps = this->clock.advance(elapsed, [this](float dt) {
+				this->core->step(dt);
+			});
+		}
+
+		if (steps > 0)
+		{
+			//Automatic checkpoint every checkpointInterval steps
+			if (this->controls.checkpointInterval > 0 && this->core->getStepCount() - this->lastCheckpoint >= this->controls.checkpointInterval)
+			{
+				ProfileScope scope("Checkpoint");
+				this->lastCheckpoint = this->core->getStepCount();
+				const bool colors = (int)this->snapshotColors.size() == this->core->getParticles().size();
+				Snapshot::save("checkpoint.l3ds", *this->core, colors ? (const float*)&this->snapshotColors[0] : NULL);
+			}
+
+			//Only quantizes, coding and writing run on the thread of the recorder
+			if (this->recorder.isOpen() && this->core->getStepCount() != this->lastCapture)
+			{
+				ProfileScope scope("Capture");
+				this->lastCapture = this->core->getStepCount();
+				this->recorder.capture(*this->core);
+			}
+		}
+
+		if (steps > 0 || !commands.empty())
+		{
+			this->publish();
+		}
+
+		//Variable steps run back to back with the measured time, fixed steps wait for the rest of the next step
+		if (!this->controls.running)
+		{
+			wait = std::chrono::duration<float>(0.1f);
+		}
+		else if (this->clock.fixedTimestep)
+		{
+			wait = std::chrono::duration<float>((1.0f - this->clock.getAlpha()) * this->clock.fixedStep);
+		}
+		else
+		{
+			wait = std::chrono::duration<float>(0.0f);
+		}
+	}
+}
+
+void SimulationThread::applyControls()
+{
+	this->core->settings = this->controls.settings;
+	const int typeCount = this->core->getTypeCount();
+	if ((int)this->controls.attraction.size() == typeCount * typeCount)
+	{
+		std::copy(this->controls.attraction.begin(), this->controls.attraction.end(), this->core->getAttractionData());
+	}
+	this->clock.fixedTimestep = this->controls.fixedTimestep;
+	this->clock.fixedStep = this->controls.fixedStep;
+	this->clock.maxSubsteps = this->controls.maxSubsteps;
+	this->clock.budget = this->controls.budget;
+}
+
+void SimulationThread::publish()
+{
+	ProfileScope scope("Publish");
+	SimulationFrame& frame = this->frames[this->back];
+
+	//Positions by id
+	Life3D_Particles& particles = this->core->getParticles();
+	frame.positions.resize(particles.size());
+	glm::vec4* positions = frame.positions.data();
+	this->core->getThreadPool()->parallelFor(0, particles.size(), 4096, [&particles, positions](int begin, int end, int worker) {
+		for (int i = begin; i < end; i++)
+		{
+			positions[particles.id[i]] = glm::vec4(particles.posX[i], particles.posY[i], particles.posZ[i], (float)particles.type[i]);
+		}
+	});
+
+	frame.time = std::chrono::steady_clock::now();
+	frame.revision = this->revision;
+	frame.stepCount = this->core->getStepCount();
+	frame.typeCount = this->core->getTypeCount();
+	frame.settings = this->core->settings;
+	frame.attraction.assign(this->core->getAttractionData(), this->core->getAttractionData() + frame.typeCount * frame.typeCount);
+	frame.neighbourStats = this->core->getNeighbourStats();
+	frame.simdLevel = this->core->getSimdLevel();
+	frame.threadCount = this->core->getThreadPool()->getThreadCount();
+	frame.substeps = this->clock.getSubsteps();
+	frame.simSpeed = this->clock.getSimSpeed();
+	frame.stepCost = this->clock.getStepCost();
+	frame.recording = this->recorder.isOpen();
+	frame.recorderStats = this->recorder.getStats();
+
+	//Commands changed settings and attraction, the controls follow
+	this->controls.settings = frame.settings;
+	this->controls.attraction = frame.attraction;
+
+	this->back = this->middle.exchange(this->back | FRESH, std::memory_order_acq_rel) & SLOT_MASK;
+}
+
+void SimulationThread::reply(const std::function<void()>& callback)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->replies.push_back(callback);
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+
+#include <glm/glm.hpp>
+
+#include "SimulationCore.h"
+#include "SimulationClock.h"
+#include "Snapshot.h"
+#include "TrajectoryRecorder.h"
+
+//Values edited by the GUI, applied by the simulation thread between two steps
+struct SimulationControls
+{
+	SimulationSettings settings;
+	std::vector<float> attraction; //typeCount * typeCount, row = type receiving the force
+	bool running;
+	int checkpointInterval;        //Steps between two automatic checkpoints, 0 = off
+
+	//Simulation clock
+	bool fixedTimestep;
+	float fixedStep;
+	int maxSubsteps;
+	float budget;
+};
+
+//State published by the simulation thread. Positions are in id order (w = type), so interpolation and colors do not depend on the memory order of the core.
+struct SimulationFrame
+{
+	std::vector<glm::vec4> positions;
+	std::chrono::steady_clock::time_point time; //Of publishing
+	int revision; //Changes after every command: settings, attraction and particles may have changed
+	int stepCount;
+	int typeCount;
+	SimulationSettings settings;
+	std::vector<float> attraction;
+	NeighbourListStats neighbourStats;
+	SimdLevel simdLevel;
+	int threadCount;
+
+	//Simulation clock
+	int substeps;
+	float simSpeed;
+	float stepCost;
+
+	bool recording;
+	RecorderStats recorderStats;
+};
+
+//Runs the simulation on its own thread, decoupled from the render loop. After its steps the thread publishes a frame into a triple buffer,
+//the render thread always takes the newest one with a single atomic exchange: neither side waits for the other. GUI changes reach the
+//thread as controls (applied before the next steps) and commands (run between two steps), so a slow step never blocks the window.
+//From construction on only the simulation thread touches the core, snapshots and recordings run there as well.
+class SimulationThread
+{
+public:
+	//Takes over core (deleted with the thread) and publishes its first frame before returning
+	SimulationThread(SimulationCore* core, const SimulationControls& controls);
+	~SimulationThread();
+
+	//Render thread------------------------------------------------------------------------------
+
+	//Newest published frame, valid until the next call
+	const SimulationFrame& acquire();
+	//Positions of the frame acquired before the current one
+	const std::vector<glm::vec4>& getPrevious();
+	//Weight of the current frame for drawing now: the previous frame at the publish time of the current one, the current frame one publish
+	//interval later (1 = no interpolation possible, a command changed the particles in between)
+	float getAlpha();
+
+	//Ignored if the simulation thread ran a command after the frame of revision (the GUI did not see the result yet)
+	void setControls(const SimulationControls& controls, int revision);
+	//command(core) runs on the simulation thread between two steps, the next frame has a new revision
+	void post(const std::function<void(SimulationCore&)>& command);
+	//Callbacks queued by the simulation thread for the render thread
+	void runReplies();
+
+	//Random colors by id written into snapshots and checkpoints, empty = type colors
+	void setSnapshotColors(const std::vector<glm::vec3>& colors);
+	void saveSnapshot(const std::string& fileName);
+	//loaded(colors) runs in runReplies after a successful load
+	void loadSnapshot(const std::string& fileName, const std::function<void(const std::vector<float>&)>& loaded);
+	void startRecording(const std::string& fileName);
+	void stopRecording();
+
+private:
+	static const int FRESH = 4; //Flag of middle: published and not acquired yet
+	static const int SLOT_MASK = 3;
+
+	//Triple buffer: the simulation thread fills back, the render thread reads front, middle holds the newest published frame
+	SimulationFrame frames[3];
+	std::atomic<int> middle;
+	int back;
+
+	//Render thread only
+	int front;
+	std::vector<glm::vec4> previous;
+	std::chrono::steady_clock::time_point previousTime;
+	int previousRevision;
+
+	//Guarded by mutex
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+	SimulationControls pendingControls;
+	int pendingRevision;
+	bool controlsChanged;
+	std::vector<std::function<void(SimulationCore&)>> commands;
+	std::vector<std::function<void()>> replies;
+	bool stop;
+	std::thread thread;
+
+	//Simulation thread only
+	SimulationCore* core;
+	SimulationClock clock;
+	SimulationControls controls;
+	int revision;
+	TrajectoryRecorder recorder;
+	int lastCapture;    //Step count at the last recorded frame
+	int lastCheckpoint; //Step count at the last checkpoint or command
+	std::vector<glm::vec3> snapshotColors;
+
+	void threadLoop();
+	void applyControls();
+	void publish();
+	void reply(const std::function<void()>& callback);
+};
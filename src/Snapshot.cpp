@@ -0,0 +1,195 @@
+#include "Snapshot.h"
+#include "MappedFile.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static unsigned long long alignOffset(unsigned long long offset)
+{
+	return (offset + Snapshot::ALIGNMENT - 1) / Snapshot::ALIGNMENT * Snapshot::ALIGNMENT;
+}
+
+bool Snapshot::save(const std::string& fileName, SimulationCore& core, const float* colors)
+{
+	Life3D_Particles& p = core.getParticles();
+	const int n = p.size();
+	const int types = core.getTypeCount();
+	const SimulationSettings& s = core.settings;
+
+	SnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "L3DS", 4);
+	header.version = VERSION;
+	header.headerSize = sizeof(SnapshotHeader);
+	header.particleCount = n;
+	header.amount = core.getAmount();
+	header.typeCount = types;
+	header.step = core.getStepCount();
+
+	header.timeFactor = s.timeFactor;
+	header.distanceMax = s.distanceMax;
+	header.cubeSize = s.cubeSize;
+	header.boundary = s.boundary;
+	header.forceLaw = s.forceLaw;
+	header.beta = s.beta;
+	header.neighbourLists = s.neighbourLists ? 1 : 0;
+	header.skin = s.skin;
+	header.halfShell = s.halfShell ? 1 : 0;
+	header.reorderInterval = s.reorderInterval;
+	header.specializedKernels = s.specializedKernels ? 1 : 0;
+	header.frictionHalfLife = s.frictionHalfLife;
+
+	const void* data[SNAPSHOT_BLOCK_COUNT] = { core.getAttractionData(), p.posX.data(), p.posY.data(), p.posZ.data(),
+		p.velX.data(), p.velY.data(), p.velZ.data(), p.type.data(), p.id.data(), colors };
+	const unsigned long long floats = (unsigned long long)n * sizeof(float);
+	const unsigned long long sizes[SNAPSHOT_BLOCK_COUNT] = { (unsigned long long)types * types * sizeof(float), floats, floats, floats,
+		floats, floats, floats, (unsigned long long)n * sizeof(int), (unsigned long long)n * sizeof(int), colors ? 3 * floats : 0 };
+
+	unsigned long long offset = alignOffset(sizeof(SnapshotHeader));
+	for (int b = 0; b < SNAPSHOT_BLOCK_COUNT; b++)
+	{
+		header.size[b] = sizes[b];
+		header.offset[b] = sizes[b] > 0 ? offset : 0;
+		offset = alignOffset(offset + sizes[b]);
+	}
+
+	//One write per block, the stream passes large writes straight through
+	const std::string tempName = fileName + ".tmp";
+	std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "ERROR::SNAPSHOT:: Could not open " << tempName << std::endl;
+		return false;
+	}
+	static const char padding[ALIGNMENT] = {};
+	unsigned long long position = sizeof(SnapshotHeader);
+	file.write((const char*)&header, sizeof(SnapshotHeader));
+	for (int b = 0; b < SNAPSHOT_BLOCK_COUNT; b++)
+	{
+		if (header.size[b] == 0)
+		{
+			continue;
+		}
+		file.write(padding, (std::streamsize)(header.offset[b] - position));
+		file.write((const char*)data[b], (std::streamsize)header.size[b]);
+		position = header.offset[b] + header.size[b];
+	}
+	file.close();
+	if (!file)
+	{
+		std::cout << "ERROR::SNAPSHOT:: Could not write " << tempName << std::endl;
+		std::remove(tempName.c_str());
+		return false;
+	}
+
+	//Replace the old file only once the new one is complete
+	std::remove(fileName.c_str());
+	if (std::rename(tempName.c_str(), fileName.c_str()) != 0)
+	{
+		std::cout << "ERROR::SNAPSHOT:: Could not rename " << tempName << " to " << fileName << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool Snapshot::load(const std::string& fileName, SimulationCore& core, std::vector<float>* colors)
+{
+	MappedFile file;
+	if (!file.open(fileName, true))
+	{
+		std::cout << "ERROR::SNAPSHOT:: Could not open " << fileName << std::endl;
+		return false;
+	}
+
+	const unsigned char* data = file.getData();
+	const size_t fileSize = file.getSize();
+	SnapshotHeader header;
+	bool valid = fileSize >= sizeof(SnapshotHeader);
+	if (valid)
+	{
+		memcpy(&header, data, sizeof(SnapshotHeader));
+		valid = memcmp(header.magic, "L3DS", 4) == 0 && header.version == VERSION && header.headerSize == (int)sizeof(SnapshotHeader)
+			&& header.typeCount >= 1 && header.typeCount <= SimulationCore::MAX_TYPES && header.amount >= 0
+			&& header.particleCount == (long long)header.amount * header.typeCount;
+	}
+	if (valid)
+	{
+		//Every block with the size the counts ask for and inside the file
+		const int n = header.particleCount;
+		const unsigned long long floats = (unsigned long long)n * sizeof(float);
+		const unsigned long long sizes[SNAPSHOT_BLOCK_COUNT] = { (unsigned long long)header.typeCount * header.typeCount * sizeof(float), floats, floats, floats,
+			floats, floats, floats, (unsigned long long)n * sizeof(int), (unsigned long long)n * sizeof(int), 3 * floats };
+		for (int b = 0; b < SNAPSHOT_BLOCK_COUNT; b++)
+		{
+			const bool optional = b == SNAPSHOT_COLORS && header.size[b] == 0;
+			valid = valid && (optional || (header.size[b] == sizes[b] && header.offset[b] <= fileSize && header.size[b] <= fileSize - header.offset[b]));
+		}
+	}
+	if (valid)
+	{
+		//The core indexes the attraction matrix with the types and the renderer its positions with the ids: every type in range, the ids a permutation of 0..n-1
+		const int n = header.particleCount;
+		const int* types = (const int*)(data + header.offset[SNAPSHOT_TYPE]);
+		const int* ids = (const int*)(data + header.offset[SNAPSHOT_ID]);
+		std::vector<bool> seen(n, false);
+		for (int i = 0; i < n && valid; i++)
+		{
+			valid = types[i] >= 0 && types[i] < header.typeCount && ids[i] >= 0 && ids[i] < n && !seen[ids[i]];
+			if (valid)
+			{
+				seen[ids[i]] = true;
+			}
+		}
+	}
+	if (!valid)
+	{
+		std::cout << "ERROR::SNAPSHOT:: " << fileName << " is not a snapshot of version " << VERSION << std::endl;
+		return false;
+	}
+
+	//No parsing: the blocks are the arrays. They are filled first, so resizing only touches the next state and the forces.
+	const int n = header.particleCount;
+	Life3D_Particles& p = core.getParticles();
+	std::vector<float>* floatBlocks[6] = { &p.posX, &p.posY, &p.posZ, &p.velX, &p.velY, &p.velZ };
+	for (int b = 0; b < 6; b++)
+	{
+		const float* block = (const float*)(data + header.offset[SNAPSHOT_POS_X + b]);
+		floatBlocks[b]->assign(block, block + n);
+	}
+	const int* types = (const int*)(data + header.offset[SNAPSHOT_TYPE]);
+	p.type.assign(types, types + n);
+	const int* ids = (const int*)(data + header.offset[SNAPSHOT_ID]);
+	p.id.assign(ids, ids + n);
+	core.resize(header.amount, header.typeCount);
+	memcpy(core.getAttractionData(), data + header.offset[SNAPSHOT_ATTRACTION], (size_t)header.size[SNAPSHOT_ATTRACTION]);
+
+	if (colors)
+	{
+		const float* block = (const float*)(data + header.offset[SNAPSHOT_COLORS]);
+		if (header.size[SNAPSHOT_COLORS] > 0)
+		{
+			colors->assign(block, block + 3 * n);
+		}
+		else
+		{
+			colors->clear();
+		}
+	}
+
+	SimulationSettings& s = core.settings;
+	s.timeFactor = header.timeFactor;
+	s.distanceMax = header.distanceMax;
+	s.cubeSize = header.cubeSize;
+	s.boundary = (BoundaryMode)header.boundary;
+	s.forceLaw = (ForceLaw)header.forceLaw;
+	s.beta = header.beta;
+	s.neighbourLists = header.neighbourLists != 0;
+	s.skin = header.skin;
+	s.halfShell = header.halfShell != 0;
+	s.reorderInterval = header.reorderInterval;
+	s.specializedKernels = header.specializedKernels != 0;
+	s.frictionHalfLife = header.frictionHalfLife;
+	core.setStepCount(header.step);
+	return true;
+}
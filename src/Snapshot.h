@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "SimulationCore.h"
+
+//Blocks of a snapshot file in the order they are written
+enum SnapshotBlock
+{
+	SNAPSHOT_ATTRACTION, //typeCount * typeCount floats, row = type receiving the force
+	SNAPSHOT_POS_X,
+	SNAPSHOT_POS_Y,
+	SNAPSHOT_POS_Z,
+	SNAPSHOT_VEL_X,
+	SNAPSHOT_VEL_Y,
+	SNAPSHOT_VEL_Z,
+	SNAPSHOT_TYPE,
+	SNAPSHOT_ID,
+	SNAPSHOT_COLORS, //Optional: 3 floats per particle, indexed by id
+	SNAPSHOT_BLOCK_COUNT
+};
+
+//Fixed size header at the start of the file, all values little endian as in memory.
+//Every block starts 64 byte aligned at its offset and holds the array exactly as the core keeps it (particle order), so loading is one copy per array.
+struct SnapshotHeader
+{
+	char magic[4]; //"L3DS"
+	int version;
+	int headerSize;
+	int particleCount;
+	int amount;
+	int typeCount;
+	int step;
+
+	//SimulationSettings, bools as 0/1
+	float timeFactor;
+	float distanceMax;
+	float cubeSize;
+	int boundary;
+	int forceLaw;
+	float beta;
+	int neighbourLists;
+	float skin;
+	int halfShell;
+	int reorderInterval;
+	int specializedKernels;
+	float frictionHalfLife;
+
+	//Byte offset and size of every block, size 0 = missing
+	unsigned long long offset[SNAPSHOT_BLOCK_COUNT];
+	unsigned long long size[SNAPSHOT_BLOCK_COUNT];
+};
+
+//Versioned binary snapshot of a simulation: particles, attraction matrix, settings and optionally the particle colors of the renderer.
+//Written with one sequential write per array into a temporary file that replaces the old one at the end (a crash never leaves a broken checkpoint),
+//loaded by mapping the file and copying the blocks straight into the particle arrays.
+class Snapshot
+{
+public:
+	//colors: 3 floats per particle indexed by id, or NULL
+	static bool save(const std::string& fileName, SimulationCore& core, const float* colors);
+	//Replaces the state of core, colors receives the stored colors (empty if the snapshot has none) if not NULL
+	static bool load(const std::string& fileName, SimulationCore& core, std::vector<float>* colors);
+
+	static const int VERSION = 2;
+	static const int ALIGNMENT = 64;
+};
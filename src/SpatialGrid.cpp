@@ -0,0 +1,149 @@
+#include "SpatialGrid.h"
+#include <algorithm>
+
+SpatialGrid::SpatialGrid()
+{
+	this->cellsPerAxis = 1;
+	this->typeCount = 1;
+	this->cubeSize = 1.0f;
+	this->invCellSize = 1.0f;
+}
+
+void SpatialGrid::build(Life3D_Particles& particles, int typeCount, float cubeSize, float cellSize)
+{
+	//Cell edge is at least cellSize, so every neighbour within cellSize lies in the 27 surrounding cells
+	float boxSize = 2.0f * cubeSize;
+	int cells = cellSize > 0.0f ? (int)(boxSize / cellSize) : MAX_CELLS_PER_AXIS;
+	this->cellsPerAxis = std::max(1, std::min(cells, (int)MAX_CELLS_PER_AXIS));
+	this->typeCount = typeCount;
+	this->cubeSize = cubeSize;
+	this->invCellSize = (float)this->cellsPerAxis / boxSize;
+
+	int bucketCount = this->cellsPerAxis * this->cellsPerAxis * this->cellsPerAxis * typeCount;
+	int n = particles.size();
+
+	this->particleBucket.resize(n);
+	this->sortedIndex.resize(n);
+	this->bucketStart.assign(bucketCount + 1, 0);
+
+	//Counting sort: histogram, exclusive prefix sum, scatter
+	for (int i = 0; i < n; i++)
+	{
+		int b = this->bucket(this->cellCoord(particles.posX[i]), this->cellCoord(particles.posY[i]), this->cellCoord(particles.posZ[i]), particles.type[i]);
+		this->particleBucket[i] = b;
+		this->bucketStart[b + 1]++;
+	}
+
+	for (int b = 0; b < bucketCount; b++)
+	{
+		this->bucketStart[b + 1] += this->bucketStart[b];
+	}
+
+	std::vector<int> fill(this->bucketStart.begin(), this->bucketStart.end() - 1);
+	for (int i = 0; i < n; i++)
+	{
+		this->sortedIndex[fill[this->particleBucket[i]]++] = i;
+	}
+
+	//Contiguous copies in cell order, the padding lies far outside of every interaction radius
+	this->sortedX.resize(n + PADDING);
+	this->sortedY.resize(n + PADDING);
+	this->sortedZ.resize(n + PADDING);
+	this->sortedType.resize(n + PADDING);
+	for (int k = 0; k < n; k++)
+	{
+		int i = this->sortedIndex[k];
+		this->sortedX[k] = particles.posX[i];
+		this->sortedY[k] = particles.posY[i];
+		this->sortedZ[k] = particles.posZ[i];
+		this->sortedType[k] = particles.type[i];
+	}
+	for (int k = n; k < n + PADDING; k++)
+	{
+		this->sortedX[k] = 1e15f;
+		this->sortedY[k] = 1e15f;
+		this->sortedZ[k] = 1e15f;
+		this->sortedType[k] = 0;
+	}
+}
+
+void SpatialGrid::refresh(Life3D_Particles& particles, int begin, int end)
+{
+	for (int k = begin; k < end; k++)
+	{
+		int i = this->sortedIndex[k];
+		this->sortedX[k] = particles.posX[i];
+		this->sortedY[k] = particles.posY[i];
+		this->sortedZ[k] = particles.posZ[i];
+	}
+}
+
+int SpatialGrid::getCellsPerAxis()
+{
+	return this->cellsPerAxis;
+}
+
+int SpatialGrid::getTypeCount()
+{
+	return this->typeCount;
+}
+
+int SpatialGrid::cellCoord(float p)
+{
+	//Particles outside of the box (borders off) are clamped into the outer cells
+	int c = (int)((p + this->cubeSize) * this->invCellSize);
+	return std::max(0, std::min(c, this->cellsPerAxis - 1));
+}
+
+int SpatialGrid::bucket(int cx, int cy, int cz, int type)
+{
+	return ((cz * this->cellsPerAxis + cy) * this->cellsPerAxis + cx) * this->typeCount + type;
+}
+
+float SpatialGrid::getCubeSize()
+{
+	return this->cubeSize;
+}
+
+float SpatialGrid::getInvCellSize()
+{
+	return this->invCellSize;
+}
+
+const int* SpatialGrid::getBucketStart()
+{
+	return this->bucketStart.data();
+}
+
+void SpatialGrid::remap(const int* newIndex, int begin, int end)
+{
+	for (int k = begin; k < end; k++)
+	{
+		this->sortedIndex[k] = newIndex[this->sortedIndex[k]];
+	}
+}
+
+const int* SpatialGrid::getSortedIndex()
+{
+	return this->sortedIndex.data();
+}
+
+const float* SpatialGrid::getSortedX()
+{
+	return this->sortedX.data();
+}
+
+const float* SpatialGrid::getSortedY()
+{
+	return this->sortedY.data();
+}
+
+const float* SpatialGrid::getSortedZ()
+{
+	return this->sortedZ.data();
+}
+
+const int* SpatialGrid::getSortedType()
+{
+	return this->sortedType.data();
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+
+#include "Life3D_Particles.h"
+
+//Uniform grid over the border box for the distanceMax neighbour search, rebuilt every step with a counting sort.
+//Particles are bucketed by (cell, type), so all particles of one type inside one cell form a contiguous range.
+class SpatialGrid
+{
+public:
+	SpatialGrid();
+
+	void build(Life3D_Particles& particles, int typeCount, float cubeSize, float cellSize);
+	//Gathers the current positions into the sorted arrays without sorting again (order of the last build)
+	void refresh(Life3D_Particles& particles, int begin, int end);
+	//Follows a permutation of the particle arrays, particle i is now newIndex[i]
+	void remap(const int* newIndex, int begin, int end);
+
+	int getCellsPerAxis();
+	int getTypeCount();
+	int cellCoord(float p);
+	int bucket(int cx, int cy, int cz, int type);
+
+	float getCubeSize();
+	float getInvCellSize();
+
+	const int* getBucketStart();
+	const int* getSortedIndex();
+
+	//Particle data gathered in sorted order, padded with PADDING unreachable entries for full width vector loads
+	const float* getSortedX();
+	const float* getSortedY();
+	const float* getSortedZ();
+	const int* getSortedType();
+
+	static const int PADDING = 16;
+
+private:
+	int cellsPerAxis;
+	int typeCount;
+	float cubeSize;
+	float invCellSize;
+
+	std::vector<int> particleBucket;
+	std::vector<int> bucketStart;
+	std::vector<int> sortedIndex;
+
+	std::vector<float> sortedX;
+	std::vector<float> sortedY;
+	std::vector<float> sortedZ;
+	std::vector<int> sortedType;
+
+	static const int MAX_CELLS_PER_AXIS = 64;
+};
+
@@ -1,11 +1,12 @@
 #include "TextRenderer.h"
 
-TextRenderer::TextRenderer(int fontSize, int w_width, int w_height)
+TextRenderer::TextRenderer(int fontSize)
 {
 	this->fontSize = fontSize;
+	this->program = 0;
+	this->textColorLocation = -1;
 	this->initFont();
 	this->initBuffer();
-	this->projection = glm::ortho(0.0f, (float)w_width, 0.0f, (float)w_height);
 }
 
 void TextRenderer::Draw(Shader& s, std::string text, float x, float y, float scale, glm::vec3 color)
@@ -13,8 +14,12 @@ void TextRenderer::Draw(Shader& s, std::string text, float x, float y, float sca
 	//@ JoeyDeVries
 // activate corresponding render state	
 	s.use();
-	s.setVec3("textColor", color);
-	s.setMat4("projection", this->projection);
+	if (s.ID != this->program)
+	{
+		this->program = s.ID;
+		this->textColorLocation = s.getUniformLocation("textColor");
+	}
+	s.setVec3(this->textColorLocation, color);
 	glActiveTexture(GL_TEXTURE0);
 	glBindVertexArray(this->VAO);
 
@@ -12,7 +12,8 @@
 class TextRenderer
 {
 public:
-	TextRenderer(int fontSize, int w_width, int w_height);
+	TextRenderer(int fontSize);
+	//The orthographic projection of s is set once with the shader (see Simulation::initShader)
 	void Draw(Shader& s, std::string text, float x, float y, float scale, glm::vec3 color);
 
 private:
@@ -29,7 +30,9 @@ private:
 
 	std::map<char, Character> Characters;
 
-	glm::mat4 projection;
+	//Location of textColor in the program of the last Draw
+	unsigned int program;
+	int textColorLocation;
 
 	//Buffer
 	unsigned int VAO;
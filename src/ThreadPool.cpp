@@ -0,0 +1,178 @@
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+ThreadPool::ThreadPool(int threadCount, bool pinThreads, const std::string& name)
+{
+	//0 = one thread per hardware thread, the calling thread counts as worker 0
+	if (threadCount <= 0)
+	{
+		threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+	}
+	this->threadCount = threadCount;
+	this->name = name;
+	this->job = nullptr;
+	this->pending = 0;
+	this->generation = 0;
+	this->stop = false;
+
+	for (int i = 0; i < threadCount; i++)
+	{
+		this->queues.push_back(std::unique_ptr<Queue>(new Queue()));
+	}
+
+	for (int i = 1; i < threadCount; i++)
+	{
+		this->workers.emplace_back(&ThreadPool::workerLoop, this, i);
+		if (pinThreads)
+		{
+			this->pin(this->workers.back(), i);
+		}
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->wakeMutex);
+		this->stop = true;
+	}
+	this->wakeCondition.notify_all();
+
+	for (auto& worker : this->workers)
+	{
+		worker.join();
+	}
+}
+
+int ThreadPool::getThreadCount()
+{
+	return this->threadCount;
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grain, const std::function<void(int, int, int)>& task)
+{
+	if (end <= begin)
+	{
+		return;
+	}
+	grain = std::max(1, grain);
+
+	int chunkCount = (end - begin + grain - 1) / grain;
+	if (chunkCount == 1 || this->threadCount == 1)
+	{
+		ProfileScope scope("Task");
+		task(begin, end, 0);
+		return;
+	}
+
+	//Publish the job before any chunk becomes visible
+	this->job = &task;
+	this->pending = chunkCount;
+
+	//Round robin distribution, neighbouring chunks end up on different workers
+	for (int c = 0; c < chunkCount; c++)
+	{
+		Queue& queue = *this->queues[c % this->threadCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.chunks.push_back({ begin + c * grain, std::min(end, begin + (c + 1) * grain) });
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(this->wakeMutex);
+		this->generation++;
+	}
+	this->wakeCondition.notify_all();
+
+	//The calling thread works as well until every chunk is done
+	while (this->pending.load() > 0)
+	{
+		if (!this->runChunk(0))
+		{
+			std::this_thread::yield();
+		}
+	}
+	this->job = nullptr;
+}
+
+void ThreadPool::workerLoop(int worker)
+{
+	Profiler::setThreadName(this->name + " " + std::to_string(worker));
+	unsigned int seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(this->wakeMutex);
+			this->wakeCondition.wait(lock, [this, seenGeneration]() { return this->stop || this->generation != seenGeneration; });
+			if (this->stop)
+			{
+				return;
+			}
+			seenGeneration = this->generation;
+		}
+
+		while (this->runChunk(worker))
+		{
+		}
+	}
+}
+
+bool ThreadPool::runChunk(int worker)
+{
+	Chunk chunk;
+	bool found = false;
+
+	//Own queue first (front), then steal from the back of the others
+	for (int i = 0; i < this->threadCount && !found; i++)
+	{
+		Queue& queue = *this->queues[(worker + i) % this->threadCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.chunks.empty())
+		{
+			if (i == 0)
+			{
+				chunk = queue.chunks.front();
+				queue.chunks.pop_front();
+			}
+			else
+			{
+				chunk = queue.chunks.back();
+				queue.chunks.pop_back();
+			}
+			found = true;
+		}
+	}
+
+	if (!found)
+	{
+		return false;
+	}
+
+	{
+		ProfileScope scope("Task");
+		(*this->job)(chunk.begin, chunk.end, worker);
+	}
+	this->pending.fetch_sub(1);
+	return true;
+}
+
+void ThreadPool::pin(std::thread& thread, int core)
+{
+	int cores = std::max(1, (int)std::thread::hardware_concurrency());
+#ifdef _WIN32
+	SetThreadAffinityMask(thread.native_handle(), (DWORD_PTR)1 << (core % cores % 64));
+#else
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core % cores, &set);
+	pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &set);
+#endif
+}
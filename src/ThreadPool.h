@@ -0,0 +1,58 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include <string>
+
+//Persistent work stealing thread pool. Workers are created once and sleep between jobs.
+//parallelFor splits an index range into chunks that are spread over per-worker queues; idle workers steal from the others.
+//Every chunk is profiled as "Task", workers are named "<name> <worker>" in the profiler.
+class ThreadPool
+{
+public:
+	ThreadPool(int threadCount = 0, bool pinThreads = false, const std::string& name = "Worker");
+	~ThreadPool();
+
+	int getThreadCount();
+
+	//task(begin, end, worker) is called for disjoint chunks of [begin, end); worker is in [0, getThreadCount())
+	void parallelFor(int begin, int end, int grain, const std::function<void(int, int, int)>& task);
+
+private:
+	struct Chunk
+	{
+		int begin;
+		int end;
+	};
+
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Chunk> chunks;
+	};
+
+	std::string name;
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<Queue>> queues;
+	int threadCount;
+
+	//Current job
+	const std::function<void(int, int, int)>* job;
+	std::atomic<int> pending;
+
+	//Wakeup
+	std::mutex wakeMutex;
+	std::condition_variable wakeCondition;
+	unsigned int generation;
+	bool stop;
+
+	void workerLoop(int worker);
+	bool runChunk(int worker);
+	void pin(std::thread& thread, int core);
+};
+
@@ -0,0 +1,413 @@
+#include "Trajectory.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//Range coder------------------------------------------------------------------------------
+
+//Binary range coder with 32 bit range and carry propagation through a cached byte (same scheme as LZMA)
+struct RangeEncoder
+{
+	std::vector<unsigned char>* output;
+	unsigned long long low;
+	unsigned int range;
+	unsigned char cache;
+	unsigned long long cacheSize;
+
+	void init(std::vector<unsigned char>* output)
+	{
+		this->output = output;
+		this->low = 0;
+		this->range = 0xFFFFFFFFu;
+		this->cache = 0;
+		this->cacheSize = 1;
+	}
+
+	void shiftLow()
+	{
+		if ((unsigned int)this->low < 0xFF000000u || (this->low >> 32) != 0)
+		{
+			unsigned char carry = (unsigned char)(this->low >> 32);
+			unsigned char byte = this->cache;
+			do
+			{
+				this->output->push_back((unsigned char)(byte + carry));
+				byte = 0xFF;
+			} while (--this->cacheSize != 0);
+			this->cache = (unsigned char)(this->low >> 24);
+		}
+		this->cacheSize++;
+		this->low = (this->low & 0x00FFFFFFu) << 8;
+	}
+
+	void normalize()
+	{
+		while (this->range < (1u << 24))
+		{
+			this->range <<= 8;
+			this->shiftLow();
+		}
+	}
+
+	void bit(unsigned short& prob, int bit, int probBits, int moveBits)
+	{
+		unsigned int bound = (this->range >> probBits) * prob;
+		if (bit == 0)
+		{
+			this->range = bound;
+			prob += ((1 << probBits) - prob) >> moveBits;
+		}
+		else
+		{
+			this->low += bound;
+			this->range -= bound;
+			prob -= prob >> moveBits;
+		}
+		this->normalize();
+	}
+
+	//Equally likely bits, up to 16 at once (range stays >= 2^8)
+	void direct(unsigned int value, int count)
+	{
+		this->range >>= count;
+		this->low += (unsigned long long)value * this->range;
+		this->normalize();
+	}
+
+	void flush()
+	{
+		for (int i = 0; i < 5; i++)
+		{
+			this->shiftLow();
+		}
+	}
+};
+
+struct RangeDecoder
+{
+	const unsigned char* data;
+	const unsigned char* end;
+	unsigned int range;
+	unsigned int code;
+	bool overrun;
+
+	unsigned int next()
+	{
+		if (this->data < this->end)
+		{
+			return *this->data++;
+		}
+		this->overrun = true;
+		return 0;
+	}
+
+	void init(const unsigned char* data, size_t size)
+	{
+		this->data = data;
+		this->end = data + size;
+		this->range = 0xFFFFFFFFu;
+		this->code = 0;
+		this->overrun = false;
+		for (int i = 0; i < 5; i++)
+		{
+			this->code = (this->code << 8) | this->next();
+		}
+	}
+
+	void normalize()
+	{
+		while (this->range < (1u << 24))
+		{
+			this->range <<= 8;
+			this->code = (this->code << 8) | this->next();
+		}
+	}
+
+	int bit(unsigned short& prob, int probBits, int moveBits)
+	{
+		unsigned int bound = (this->range >> probBits) * prob;
+		int bit;
+		if (this->code < bound)
+		{
+			this->range = bound;
+			prob += ((1 << probBits) - prob) >> moveBits;
+			bit = 0;
+		}
+		else
+		{
+			this->code -= bound;
+			this->range -= bound;
+			prob -= prob >> moveBits;
+			bit = 1;
+		}
+		this->normalize();
+		return bit;
+	}
+
+	unsigned int direct(int count)
+	{
+		this->range >>= count;
+		unsigned int value = this->code / this->range;
+		if (value >> count)
+		{
+			//Only possible for broken data
+			this->overrun = true;
+			value &= (1u << count) - 1;
+		}
+		this->code -= value * this->range;
+		this->normalize();
+		return value;
+	}
+};
+
+//Helper------------------------------------------------------------------------------
+
+static inline int bitLength(unsigned int value)
+{
+	if (value == 0)
+	{
+		return 0;
+	}
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse(&index, value);
+	return (int)index + 1;
+#else
+	return 32 - __builtin_clz(value);
+#endif
+}
+
+static inline unsigned int zigzag(int value)
+{
+	return ((unsigned int)value << 1) ^ (unsigned int)(value >> 31);
+}
+
+static inline int unzigzag(unsigned int value)
+{
+	return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+//Quantizer------------------------------------------------------------------------------
+
+void TrajectoryQuantizer::init(float cubeSize, int bits)
+{
+	this->cubeSize = cubeSize;
+	this->scale = (float)((1 << bits) - 1) / (2.0f * cubeSize);
+}
+
+int TrajectoryQuantizer::quantize(float pos) const
+{
+	//Far outside the box (open border) the values are clamped to stay within an int
+	float value = (pos + this->cubeSize) * this->scale;
+	value = std::min(std::max(value, -1073741824.0f), 1073741824.0f);
+	return (int)std::floor(value + 0.5f);
+}
+
+float TrajectoryQuantizer::dequantize(int value) const
+{
+	return (float)value / this->scale - this->cubeSize;
+}
+
+//Codec------------------------------------------------------------------------------
+
+TrajectoryCodec::TrajectoryCodec(int particleCount)
+{
+	this->particleCount = particleCount;
+	this->chunkCount = (particleCount + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	this->previous.resize(3 * (size_t)particleCount);
+	this->movement.resize(3 * (size_t)particleCount);
+	this->previousClass.resize(3 * (size_t)particleCount);
+	this->models.resize(this->chunkCount);
+	for (int c = 0; c < this->chunkCount; c++)
+	{
+		this->resetChunk(c);
+	}
+}
+
+void TrajectoryCodec::resetChunk(int chunk)
+{
+	const int n = this->particleCount;
+	const int begin = chunk * CHUNK_SIZE;
+	const int end = std::min(begin + CHUNK_SIZE, n);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const size_t offset = (size_t)axis * n;
+		std::fill(this->previous.begin() + offset + begin, this->previous.begin() + offset + end, 0);
+		std::fill(this->movement.begin() + offset + begin, this->movement.begin() + offset + end, 0);
+		std::fill(this->previousClass.begin() + offset + begin, this->previousClass.begin() + offset + end, 0);
+	}
+	Models& models = this->models[chunk];
+	std::fill(&models.classModel[0][0][0], &models.classModel[0][0][0] + sizeof(models.classModel) / sizeof(unsigned short), (unsigned short)(1 << (PROB_BITS - 1)));
+	std::fill(&models.mantissaModel[0][0], &models.mantissaModel[0][0] + sizeof(models.mantissaModel) / sizeof(unsigned short), (unsigned short)(1 << (PROB_BITS - 1)));
+}
+
+void TrajectoryCodec::encode(const int* values, bool keyframe, std::vector<unsigned char>& output)
+{
+	//Size table first, filled in once the chunk is coded
+	const size_t table = output.size();
+	output.resize(table + (size_t)this->chunkCount * sizeof(unsigned int));
+	for (int c = 0; c < this->chunkCount; c++)
+	{
+		const size_t start = output.size();
+		this->encodeChunk(c, values, keyframe, output);
+		unsigned int size = (unsigned int)(output.size() - start);
+		memcpy(&output[table + c * sizeof(unsigned int)], &size, sizeof(unsigned int));
+	}
+}
+
+bool TrajectoryCodec::decode(const unsigned char* data, size_t size, bool keyframe, int* values, ThreadPool* pool)
+{
+	const size_t table = (size_t)this->chunkCount * sizeof(unsigned int);
+	if (size < table)
+	{
+		return false;
+	}
+	std::vector<size_t> offsets(this->chunkCount + 1);
+	offsets[0] = table;
+	for (int c = 0; c < this->chunkCount; c++)
+	{
+		unsigned int chunkSize;
+		memcpy(&chunkSize, data + c * sizeof(unsigned int), sizeof(unsigned int));
+		offsets[c + 1] = offsets[c] + chunkSize;
+	}
+	if (offsets[this->chunkCount] > size)
+	{
+		return false;
+	}
+
+	std::vector<unsigned char> valid(this->chunkCount, 0);
+	auto task = [this, data, keyframe, values, &offsets, &valid](int begin, int end, int worker) {
+		for (int c = begin; c < end; c++)
+		{
+			valid[c] = this->decodeChunk(c, data + offsets[c], offsets[c + 1] - offsets[c], keyframe, values) ? 1 : 0;
+		}
+	};
+	if (pool)
+	{
+		pool->parallelFor(0, this->chunkCount, 1, task);
+	}
+	else
+	{
+		task(0, this->chunkCount, 0);
+	}
+	return std::find(valid.begin(), valid.end(), 0) == valid.end();
+}
+
+void TrajectoryCodec::encodeChunk(int chunk, const int* values, bool keyframe, std::vector<unsigned char>& output)
+{
+	if (keyframe)
+	{
+		this->resetChunk(chunk);
+	}
+	RangeEncoder coder;
+	coder.init(&output);
+
+	const int n = this->particleCount;
+	const int begin = chunk * CHUNK_SIZE;
+	const int end = std::min(begin + CHUNK_SIZE, n);
+	Models& models = this->models[chunk];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const int* value = values + (size_t)axis * n;
+		int* previous = &this->previous[(size_t)axis * n];
+		int* movement = &this->movement[(size_t)axis * n];
+		unsigned char* previousClass = &this->previousClass[(size_t)axis * n];
+		unsigned short* mantissaModel = models.mantissaModel[axis];
+		for (int i = begin; i < end; i++)
+		{
+			//Unsigned differences wrap the same way in the decoder, no overflow far outside the box
+			unsigned int z = zigzag((int)((unsigned int)value[i] - (unsigned int)previous[i] - (unsigned int)movement[i]));
+			movement[i] = keyframe ? 0 : (int)((unsigned int)value[i] - (unsigned int)previous[i]);
+			previous[i] = value[i];
+			int length = bitLength(z);
+
+			//Bit length as binary tree, most significant bit first
+			unsigned short* classModel = models.classModel[axis][previousClass[i]];
+			int node = 1;
+			for (int b = CLASS_BITS - 1; b >= 0; b--)
+			{
+				int bit = (length >> b) & 1;
+				coder.bit(classModel[node], bit, PROB_BITS, MOVE_BITS);
+				node = (node << 1) | bit;
+			}
+
+			//Leading one is implicit
+			if (length >= 2)
+			{
+				coder.bit(mantissaModel[length], (z >> (length - 2)) & 1, PROB_BITS, MOVE_BITS);
+				int rest = length - 2;
+				while (rest > 0)
+				{
+					int count = std::min(rest, 16);
+					rest -= count;
+					coder.direct((z >> rest) & ((1u << count) - 1), count);
+				}
+			}
+
+			//Keyframes hold positions, their lengths say nothing about the movement
+			previousClass[i] = keyframe ? 0 : (unsigned char)std::min(length, CONTEXTS - 1);
+		}
+	}
+	coder.flush();
+}
+
+bool TrajectoryCodec::decodeChunk(int chunk, const unsigned char* data, size_t size, bool keyframe, int* values)
+{
+	if (keyframe)
+	{
+		this->resetChunk(chunk);
+	}
+	RangeDecoder coder;
+	coder.init(data, size);
+
+	const int n = this->particleCount;
+	const int begin = chunk * CHUNK_SIZE;
+	const int end = std::min(begin + CHUNK_SIZE, n);
+	Models& models = this->models[chunk];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		int* value = values + (size_t)axis * n;
+		int* previous = &this->previous[(size_t)axis * n];
+		int* movement = &this->movement[(size_t)axis * n];
+		unsigned char* previousClass = &this->previousClass[(size_t)axis * n];
+		unsigned short* mantissaModel = models.mantissaModel[axis];
+		for (int i = begin; i < end; i++)
+		{
+			unsigned short* classModel = models.classModel[axis][previousClass[i]];
+			int node = 1;
+			for (int b = 0; b < CLASS_BITS; b++)
+			{
+				node = (node << 1) | coder.bit(classModel[node], PROB_BITS, MOVE_BITS);
+			}
+			int length = std::min(node - (1 << CLASS_BITS), 32);
+
+			unsigned int z = 0;
+			if (length >= 1)
+			{
+				z = 1;
+			}
+			if (length >= 2)
+			{
+				z = (z << 1) | (unsigned int)coder.bit(mantissaModel[length], PROB_BITS, MOVE_BITS);
+				int rest = length - 2;
+				while (rest > 0)
+				{
+					int count = std::min(rest, 16);
+					rest -= count;
+					z = (z << count) | coder.direct(count);
+				}
+			}
+
+			value[i] = (int)((unsigned int)previous[i] + (unsigned int)movement[i] + (unsigned int)unzigzag(z));
+			movement[i] = keyframe ? 0 : (int)((unsigned int)value[i] - (unsigned int)previous[i]);
+			previous[i] = value[i];
+			previousClass[i] = keyframe ? 0 : (unsigned char)std::min(length, CONTEXTS - 1);
+		}
+	}
+	return !coder.overrun;
+}
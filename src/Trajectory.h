@@ -0,0 +1,95 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+class ThreadPool;
+
+//Trajectory file (.l3dt): TrajectoryHeader, the type of every particle (particleCount ints, indexed by id), the frames and at indexOffset one
+//TrajectoryIndexEntry per frame. Every frame is a TrajectoryFrameHeader followed by size bytes coded with TrajectoryCodec.
+//Positions are quantized to bits bits over [-cubeSize, cubeSize] (cubeSize of the start of the recording), values outside the box stay representable.
+
+struct TrajectoryHeader
+{
+	char magic[4]; //"L3DT"
+	int version;
+	int headerSize;
+	int particleCount;
+	int typeCount;
+	int bits;
+	float cubeSize;
+	int keyframeInterval; //Frames between two keyframes
+	int frameCount;       //Written on close, 0 = recording was not closed (frames can still be read one after another)
+	int reserved;
+	unsigned long long indexOffset;
+};
+
+struct TrajectoryFrameHeader
+{
+	int step;
+	int keyframe; //Absolute values, decoding can start here
+	unsigned int size;
+	int reserved;
+};
+
+struct TrajectoryIndexEntry
+{
+	unsigned long long offset; //Of the frame header
+	int step;
+	int keyframe;
+};
+
+//Quantization of positions to integers and back
+struct TrajectoryQuantizer
+{
+	float cubeSize;
+	float scale;
+
+	void init(float cubeSize, int bits);
+	int quantize(float pos) const;
+	float dequantize(int value) const;
+};
+
+//Frame codec: keyframes code the quantized positions, the other frames the difference to the previous frame of every particle,
+//predicted to continue the movement between the two frames before (half the size of a plain difference, particles move steadily).
+//Values are coded with an adaptive binary range coder: the bit length of the zigzag value (context = bit length of the same particle
+//and axis in the previous frame, movement is steady), the bit below the leading one with a model and the rest as plain bits.
+//The particles are coded in chunks of CHUNK_SIZE with their own coder and models, a frame starts with the byte size of every chunk
+//(unsigned int) followed by the chunks, so the chunks of a frame can be decoded in parallel.
+//Encoder and decoder keep the same state, frames have to be passed in order starting at a keyframe.
+class TrajectoryCodec
+{
+public:
+	TrajectoryCodec(int particleCount = 0);
+
+	//values: x of all particles, then y, then z (id order)
+	void encode(const int* values, bool keyframe, std::vector<unsigned char>& output);
+	//Chunks are spread over pool if not NULL
+	bool decode(const unsigned char* data, size_t size, bool keyframe, int* values, ThreadPool* pool = NULL);
+
+	static const int VERSION = 2;
+	static const int CHUNK_SIZE = 16384;
+
+private:
+	static const int PROB_BITS = 11;
+	static const int MOVE_BITS = 5;
+	static const int CLASS_BITS = 6;
+	static const int CONTEXTS = 20;
+
+	//Adaptive probabilities of a 0 bit, per axis
+	struct Models
+	{
+		unsigned short classModel[3][CONTEXTS][1 << CLASS_BITS];
+		unsigned short mantissaModel[3][33];
+	};
+
+	int particleCount;
+	int chunkCount;
+	std::vector<int> previous;
+	std::vector<int> movement;
+	std::vector<unsigned char> previousClass;
+	std::vector<Models> models; //Per chunk
+
+	void resetChunk(int chunk);
+	void encodeChunk(int chunk, const int* values, bool keyframe, std::vector<unsigned char>& output);
+	bool decodeChunk(int chunk, const unsigned char* data, size_t size, bool keyframe, int* values);
+};
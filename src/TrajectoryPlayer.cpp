@@ -0,0 +1,341 @@
+#include "TrajectoryPlayer.h"
+#include "Profiler.h"
+#include "SimulationCore.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+TrajectoryPlayer::TrajectoryPlayer()
+{
+	this->playing = false;
+	this->speed = 60.0f;
+	this->position = 0.0f;
+	this->shownFrame = -1;
+	this->pool = NULL;
+	this->decodedFrame = -1;
+	this->requestedFrame = -1;
+	this->failedFrame = -1;
+	this->readyFrame = -1;
+	this->fresh = false;
+	this->stop = false;
+	memset(&this->header, 0, sizeof(this->header));
+}
+
+TrajectoryPlayer::~TrajectoryPlayer()
+{
+	this->close();
+}
+
+bool TrajectoryPlayer::open(const std::string& fileName, int threadCount)
+{
+	this->close();
+	if (!this->file.open(fileName, false))
+	{
+		std::cout << "ERROR::PLAYER:: Could not open " << fileName << std::endl;
+		return false;
+	}
+	if (!this->readIndex())
+	{
+		std::cout << "ERROR::PLAYER:: " << fileName << " is not a trajectory of version " << TrajectoryCodec::VERSION << std::endl;
+		this->file.close();
+		return false;
+	}
+
+	const int n = this->header.particleCount;
+	this->quantizer.init(this->header.cubeSize, this->header.bits);
+	this->codec = TrajectoryCodec(n);
+	this->values.assign(3 * (size_t)n, 0);
+	this->back.assign(n, glm::vec3(0.0f));
+	this->ready.assign(n, glm::vec3(0.0f));
+	this->pool = new ThreadPool(threadCount, false, "Player");
+
+	this->playing = false;
+	this->position = 0.0f;
+	this->shownFrame = -1;
+	this->decodedFrame = -1;
+	this->failedFrame = -1;
+	this->readyFrame = -1;
+	this->fresh = false;
+	this->stop = false;
+	this->requestedFrame = 0;
+	this->worker = std::thread(&TrajectoryPlayer::workerLoop, this);
+	return true;
+}
+
+bool TrajectoryPlayer::readIndex()
+{
+	const unsigned char* data = this->file.getData();
+	const size_t size = this->file.getSize();
+	if (size < sizeof(TrajectoryHeader))
+	{
+		return false;
+	}
+	memcpy(&this->header, data, sizeof(TrajectoryHeader));
+	const TrajectoryHeader& h = this->header;
+	const unsigned long long typesEnd = sizeof(TrajectoryHeader) + (unsigned long long)h.particleCount * sizeof(int);
+	if (memcmp(h.magic, "L3DT", 4) != 0 || h.version != TrajectoryCodec::VERSION || h.headerSize != (int)sizeof(TrajectoryHeader)
+		|| h.particleCount <= 0 || h.typeCount < 1 || h.typeCount > SimulationCore::MAX_TYPES || h.bits < 4 || h.bits > 24 || !(h.cubeSize > 0.0f) || typesEnd > size)
+	{
+		return false;
+	}
+	//The renderer indexes its color table with the types
+	const int* types = (const int*)(data + sizeof(TrajectoryHeader));
+	for (int i = 0; i < h.particleCount; i++)
+	{
+		if (types[i] < 0 || types[i] >= h.typeCount)
+		{
+			return false;
+		}
+	}
+	this->types.assign(types, types + h.particleCount);
+
+	this->index.clear();
+	if (h.frameCount > 0 && h.indexOffset <= size && (unsigned long long)h.frameCount * sizeof(TrajectoryIndexEntry) <= size - h.indexOffset)
+	{
+		const TrajectoryIndexEntry* entries = (const TrajectoryIndexEntry*)(data + h.indexOffset);
+		this->index.assign(entries, entries + h.frameCount);
+	}
+	else
+	{
+		//Recording was not closed: walk the frames up to the first incomplete one
+		unsigned long long offset = typesEnd;
+		while (offset + sizeof(TrajectoryFrameHeader) <= size)
+		{
+			TrajectoryFrameHeader frameHeader;
+			memcpy(&frameHeader, data + offset, sizeof(TrajectoryFrameHeader));
+			if (frameHeader.size > size - offset - sizeof(TrajectoryFrameHeader))
+			{
+				break;
+			}
+			TrajectoryIndexEntry entry;
+			entry.offset = offset;
+			entry.step = frameHeader.step;
+			entry.keyframe = frameHeader.keyframe;
+			this->index.push_back(entry);
+			offset += sizeof(TrajectoryFrameHeader) + frameHeader.size;
+		}
+	}
+
+	//Every frame needs a keyframe at or before it, recordings start with one
+	if (this->index.empty() || !this->index[0].keyframe)
+	{
+		return false;
+	}
+	this->keyframeOf.resize(this->index.size());
+	int keyframe = 0;
+	for (int f = 0; f < (int)this->index.size(); f++)
+	{
+		if (this->index[f].keyframe)
+		{
+			keyframe = f;
+		}
+		this->keyframeOf[f] = keyframe;
+	}
+	return true;
+}
+
+void TrajectoryPlayer::close()
+{
+	if (!this->file.isOpen())
+	{
+		return;
+	}
+	if (this->worker.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->stop = true;
+		}
+		this->wakeCondition.notify_one();
+		this->worker.join();
+	}
+	delete this->pool;
+	this->pool = NULL;
+	this->file.close();
+	this->index.clear();
+	this->playing = false;
+}
+
+bool TrajectoryPlayer::isOpen()
+{
+	return this->file.isOpen();
+}
+
+//Render thread------------------------------------------------------------------------------
+
+void TrajectoryPlayer::advance(float deltaTime)
+{
+	if (!this->isOpen() || !this->playing)
+	{
+		return;
+	}
+	const float last = (float)(this->index.size() - 1);
+	this->position += this->speed * deltaTime;
+	if (this->position >= last)
+	{
+		this->position = last;
+		this->playing = false;
+	}
+	this->request((int)this->position);
+}
+
+void TrajectoryPlayer::seek(int frame)
+{
+	if (!this->isOpen())
+	{
+		return;
+	}
+	frame = std::min(std::max(frame, 0), (int)this->index.size() - 1);
+	this->position = (float)frame;
+	this->request(frame);
+}
+
+void TrajectoryPlayer::request(int frame)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (this->requestedFrame == frame)
+		{
+			return;
+		}
+		this->requestedFrame = frame;
+	}
+	this->wakeCondition.notify_one();
+}
+
+bool TrajectoryPlayer::fetch(std::vector<glm::vec3>& positions)
+{
+	if (!this->isOpen())
+	{
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (!this->fresh || positions.size() != this->ready.size())
+	{
+		return false;
+	}
+	std::swap(positions, this->ready);
+	this->shownFrame = this->readyFrame;
+	this->fresh = false;
+	return true;
+}
+
+int TrajectoryPlayer::getParticleCount()
+{
+	return this->header.particleCount;
+}
+
+int TrajectoryPlayer::getTypeCount()
+{
+	return this->header.typeCount;
+}
+
+const std::vector<int>& TrajectoryPlayer::getTypes()
+{
+	return this->types;
+}
+
+int TrajectoryPlayer::getFrameCount()
+{
+	return (int)this->index.size();
+}
+
+int TrajectoryPlayer::getFrame()
+{
+	return (int)this->position;
+}
+
+int TrajectoryPlayer::getShownFrame()
+{
+	return this->shownFrame;
+}
+
+int TrajectoryPlayer::getShownStep()
+{
+	return this->shownFrame >= 0 ? this->index[this->shownFrame].step : 0;
+}
+
+//Worker thread------------------------------------------------------------------------------
+
+void TrajectoryPlayer::workerLoop()
+{
+	Profiler::setThreadName("Player");
+	while (true)
+	{
+		int target;
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->wakeCondition.wait(lock, [this] {
+				return this->stop || (this->requestedFrame != this->decodedFrame && this->requestedFrame != this->failedFrame);
+			});
+			if (this->stop)
+			{
+				return;
+			}
+			target = this->requestedFrame;
+		}
+
+		if (!this->decodeTo(target))
+		{
+			std::cout << "ERROR::PLAYER:: Frame " << target << " is broken" << std::endl;
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->failedFrame = target;
+			continue;
+		}
+		this->buildPositions();
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+		std::swap(this->back, this->ready);
+		this->readyFrame = this->decodedFrame;
+		this->fresh = true;
+	}
+}
+
+bool TrajectoryPlayer::decodeTo(int frame)
+{
+	ProfileScope scope("Decode");
+	//Continue from the decoded frame if no keyframe lies in between, else start at the keyframe
+	int first = this->decodedFrame + 1;
+	if (this->decodedFrame < 0 || frame <= this->decodedFrame || this->keyframeOf[frame] > this->decodedFrame)
+	{
+		first = this->keyframeOf[frame];
+	}
+	const unsigned char* data = this->file.getData();
+	const size_t size = this->file.getSize();
+	for (int f = first; f <= frame; f++)
+	{
+		const TrajectoryIndexEntry& entry = this->index[f];
+		TrajectoryFrameHeader frameHeader;
+		if (entry.offset + sizeof(TrajectoryFrameHeader) > size)
+		{
+			this->decodedFrame = -1;
+			return false;
+		}
+		memcpy(&frameHeader, data + entry.offset, sizeof(TrajectoryFrameHeader));
+		if (frameHeader.size > size - entry.offset - sizeof(TrajectoryFrameHeader)
+			|| !this->codec.decode(data + entry.offset + sizeof(TrajectoryFrameHeader), frameHeader.size, frameHeader.keyframe != 0, this->values.data(), this->pool))
+		{
+			this->decodedFrame = -1;
+			return false;
+		}
+		this->decodedFrame = f;
+	}
+	return true;
+}
+
+void TrajectoryPlayer::buildPositions()
+{
+	ProfileScope scope("Positions");
+	const int n = this->header.particleCount;
+	const int* x = this->values.data();
+	const int* y = x + n;
+	const int* z = y + n;
+	glm::vec3* positions = this->back.data();
+	const TrajectoryQuantizer& quantizer = this->quantizer;
+	this->pool->parallelFor(0, n, 4096, [positions, x, y, z, &quantizer](int begin, int end, int worker) {
+		for (int i = begin; i < end; i++)
+		{
+			positions[i] = glm::vec3(quantizer.dequantize(x[i]), quantizer.dequantize(y[i]), quantizer.dequantize(z[i]));
+		}
+	});
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <glm/glm.hpp>
+
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "Trajectory.h"
+
+//Plays a recorded trajectory (see TrajectoryRecorder) without simulating. The file is mapped, a worker thread decodes the requested
+//frame (chunks spread over its own thread pool) and dequantizes the positions in id order. Decoded positions are handed over by
+//swapping buffers, the render thread never waits for decoding. Seeking starts at the keyframe before the frame unless it lies ahead
+//of the last decoded frame with no keyframe in between.
+class TrajectoryPlayer
+{
+public:
+	TrajectoryPlayer();
+	~TrajectoryPlayer();
+
+	//threadCount: decoding threads, 0 = all hardware threads
+	bool open(const std::string& fileName, int threadCount = 0);
+	void close();
+	bool isOpen();
+
+	//Render thread------------------------------------------------------------------------------
+
+	//Moves the play position by speed frames per second while playing, stops at the last frame
+	void advance(float deltaTime);
+	//Scrubbing
+	void seek(int frame);
+	//Swaps the newest decoded positions into positions (getParticleCount() positions), false = nothing new since the last call
+	bool fetch(std::vector<glm::vec3>& positions);
+
+	int getParticleCount();
+	int getTypeCount();
+	const std::vector<int>& getTypes(); //Indexed by id
+	int getFrameCount();
+	int getFrame();     //Play position
+	int getShownFrame(); //Frame of the positions fetched last, -1 = none yet
+	int getShownStep();
+
+	//Playback settings, GUI widgets point directly at them
+	bool playing;
+	float speed; //Frames per second
+
+private:
+	MappedFile file;
+	TrajectoryHeader header;
+	TrajectoryQuantizer quantizer;
+	std::vector<int> types;
+	std::vector<TrajectoryIndexEntry> index;
+	std::vector<int> keyframeOf; //Keyframe decoding has to start at for every frame
+	float position;
+	int shownFrame;
+
+	//Worker thread only
+	ThreadPool* pool;
+	TrajectoryCodec codec;
+	std::vector<int> values; //Quantized positions of decodedFrame
+	std::vector<glm::vec3> back;
+	int decodedFrame;        //State of the codec, -1 = none
+
+	//Guarded by mutex
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+	std::vector<glm::vec3> ready;
+	int requestedFrame;
+	int failedFrame;
+	int readyFrame;
+	bool fresh;
+	bool stop;
+	std::thread worker;
+
+	bool readIndex();
+	void request(int frame);
+	void workerLoop();
+	bool decodeTo(int frame);
+	void buildPositions();
+};
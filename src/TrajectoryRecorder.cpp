@@ -0,0 +1,231 @@
+#include "TrajectoryRecorder.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+TrajectoryRecorder::TrajectoryRecorder()
+{
+	this->stop = false;
+	this->position = 0;
+	this->particleCount = 0;
+	this->recording = false;
+	memset(&this->header, 0, sizeof(this->header));
+	memset(&this->stats, 0, sizeof(this->stats));
+}
+
+TrajectoryRecorder::~TrajectoryRecorder()
+{
+	this->close();
+}
+
+bool TrajectoryRecorder::open(const std::string& fileName, SimulationCore& core, int keyframeInterval, int bits, int bufferCount)
+{
+	this->close();
+	if (keyframeInterval < 1 || bits < 4 || bits > 24 || bufferCount < 1)
+	{
+		std::cout << "ERROR::RECORDER:: Invalid keyframe interval, bits or buffer count" << std::endl;
+		return false;
+	}
+
+	this->file.open(fileName, std::ios::binary | std::ios::trunc);
+	if (!this->file)
+	{
+		std::cout << "ERROR::RECORDER:: Could not open " << fileName << std::endl;
+		return false;
+	}
+
+	Life3D_Particles& p = core.getParticles();
+	const int n = p.size();
+	this->particleCount = n;
+	this->quantizer.init(core.settings.cubeSize, bits);
+
+	memset(&this->header, 0, sizeof(this->header));
+	memcpy(this->header.magic, "L3DT", 4);
+	this->header.version = TrajectoryCodec::VERSION;
+	this->header.headerSize = sizeof(TrajectoryHeader);
+	this->header.particleCount = n;
+	this->header.typeCount = core.getTypeCount();
+	this->header.bits = bits;
+	this->header.cubeSize = core.settings.cubeSize;
+	this->header.keyframeInterval = keyframeInterval;
+	this->file.write((const char*)&this->header, sizeof(TrajectoryHeader));
+
+	//Types in id order, they do not change during a recording
+	std::vector<int> types(n);
+	for (int i = 0; i < n; i++)
+	{
+		types[p.id[i]] = p.type[i];
+	}
+	this->file.write((const char*)types.data(), (std::streamsize)n * sizeof(int));
+	this->position = sizeof(TrajectoryHeader) + (unsigned long long)n * sizeof(int);
+
+	this->codec = TrajectoryCodec(n);
+	this->index.clear();
+	this->frames.assign(bufferCount, Frame());
+	this->freeFrames.clear();
+	this->queuedFrames.clear();
+	for (int i = 0; i < bufferCount; i++)
+	{
+		this->frames[i].values.resize(3 * (size_t)n);
+		this->freeFrames.push_back(i);
+	}
+
+	memset(&this->stats, 0, sizeof(this->stats));
+	this->stats.writtenBytes = this->position;
+	this->startTime = std::chrono::steady_clock::now();
+	this->stop = false;
+	this->recording = true;
+	this->writer = std::thread(&TrajectoryRecorder::writerLoop, this);
+	return true;
+}
+
+bool TrajectoryRecorder::capture(SimulationCore& core)
+{
+	if (!this->recording)
+	{
+		return false;
+	}
+	Life3D_Particles& p = core.getParticles();
+	const int n = this->particleCount;
+	if (p.size() != n)
+	{
+		//Particles were recreated, the recording only holds the ones of its start
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stats.dropped++;
+		return false;
+	}
+
+	int k;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (this->freeFrames.empty())
+		{
+			this->stats.dropped++;
+			return false;
+		}
+		k = this->freeFrames.front();
+		this->freeFrames.pop_front();
+	}
+
+	//Quantize in id order, the codec predicts every particle from its own previous position
+	Frame& frame = this->frames[k];
+	frame.step = core.getStepCount();
+	int* x = &frame.values[0];
+	int* y = x + n;
+	int* z = y + n;
+	for (int i = 0; i < n; i++)
+	{
+		const int id = p.id[i];
+		x[id] = this->quantizer.quantize(p.posX[i]);
+		y[id] = this->quantizer.quantize(p.posY[i]);
+		z[id] = this->quantizer.quantize(p.posZ[i]);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->queuedFrames.push_back(k);
+	}
+	this->wakeCondition.notify_one();
+	return true;
+}
+
+void TrajectoryRecorder::close()
+{
+	if (!this->recording)
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stop = true;
+	}
+	this->wakeCondition.notify_one();
+	this->writer.join();
+
+	//Index for seeking, then the header with the final counts
+	this->file.write((const char*)this->index.data(), (std::streamsize)(this->index.size() * sizeof(TrajectoryIndexEntry)));
+	this->header.frameCount = (int)this->index.size();
+	this->header.indexOffset = this->position;
+	this->file.seekp(0);
+	this->file.write((const char*)&this->header, sizeof(TrajectoryHeader));
+	this->file.close();
+	if (!this->file)
+	{
+		std::cout << "ERROR::RECORDER:: Could not write the trajectory" << std::endl;
+	}
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->stats.writtenBytes = this->position + this->index.size() * sizeof(TrajectoryIndexEntry);
+	this->stats.bytesPerSecond = this->stats.writtenBytes / std::max(1e-6, std::chrono::duration<double>(std::chrono::steady_clock::now() - this->startTime).count());
+	this->recording = false;
+}
+
+bool TrajectoryRecorder::isOpen()
+{
+	return this->recording;
+}
+
+RecorderStats TrajectoryRecorder::getStats()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	RecorderStats stats = this->stats;
+	stats.ratio = stats.writtenBytes > 0 ? (double)stats.rawBytes / stats.writtenBytes : 0.0;
+	if (this->recording)
+	{
+		stats.bytesPerSecond = stats.writtenBytes / std::max(1e-6, std::chrono::duration<double>(std::chrono::steady_clock::now() - this->startTime).count());
+	}
+	return stats;
+}
+
+void TrajectoryRecorder::writerLoop()
+{
+	Profiler::setThreadName("Recorder");
+	while (true)
+	{
+		int k;
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->wakeCondition.wait(lock, [this] { return this->stop || !this->queuedFrames.empty(); });
+			if (this->queuedFrames.empty())
+			{
+				//Stopped and drained
+				return;
+			}
+			k = this->queuedFrames.front();
+			this->queuedFrames.pop_front();
+		}
+
+		this->writeFrame(this->frames[k]);
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->freeFrames.push_back(k);
+		this->stats.frames++;
+		this->stats.rawBytes += 3ULL * this->particleCount * sizeof(float);
+		this->stats.writtenBytes = this->position;
+	}
+}
+
+void TrajectoryRecorder::writeFrame(Frame& frame)
+{
+	//Every keyframeInterval written frames (dropped frames do not count) decoding can start without the frames before
+	const bool keyframe = this->index.size() % this->header.keyframeInterval == 0;
+	ProfileScope scope("WriteFrame");
+	this->payload.clear();
+	this->codec.encode(frame.values.data(), keyframe, this->payload);
+
+	TrajectoryFrameHeader frameHeader;
+	frameHeader.step = frame.step;
+	frameHeader.keyframe = keyframe ? 1 : 0;
+	frameHeader.size = (unsigned int)this->payload.size();
+	frameHeader.reserved = 0;
+	this->file.write((const char*)&frameHeader, sizeof(TrajectoryFrameHeader));
+	this->file.write((const char*)this->payload.data(), (std::streamsize)this->payload.size());
+
+	TrajectoryIndexEntry entry;
+	entry.offset = this->position;
+	entry.step = frame.step;
+	entry.keyframe = frameHeader.keyframe;
+	this->index.push_back(entry);
+	this->position += sizeof(TrajectoryFrameHeader) + this->payload.size();
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#include "SimulationCore.h"
+#include "Trajectory.h"
+
+struct RecorderStats
+{
+	int frames;                     //Written
+	int dropped;                    //Captures skipped because the writer was behind
+	unsigned long long rawBytes;    //Same frames as float x, y, z
+	unsigned long long writtenBytes;
+	double ratio;                   //rawBytes / writtenBytes
+	double bytesPerSecond;          //Written since open
+};
+
+//Streams quantized, delta coded frames of the particle positions into a trajectory file (see Trajectory.h).
+//capture() only copies the quantized positions into a free frame buffer, coding and writing happen on a background thread.
+//If all buffers are still queued the frame is dropped, the simulation thread never waits for the disk.
+class TrajectoryRecorder
+{
+public:
+	TrajectoryRecorder();
+	~TrajectoryRecorder();
+
+	//keyframeInterval: frames between two keyframes (seek points), bits: quantization of the box edge
+	bool open(const std::string& fileName, SimulationCore& core, int keyframeInterval = 60, int bits = 16, int bufferCount = 4);
+	//false = dropped or not open
+	bool capture(SimulationCore& core);
+	//Writes the remaining frames and the index
+	void close();
+
+	bool isOpen();
+	RecorderStats getStats();
+
+private:
+	struct Frame
+	{
+		int step;
+		std::vector<int> values; //x, y, z blocks in id order
+	};
+
+	std::vector<Frame> frames;
+	std::deque<int> freeFrames;
+	std::deque<int> queuedFrames;
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+	bool stop;
+	std::thread writer;
+
+	//Writer thread only
+	std::ofstream file;
+	TrajectoryCodec codec;
+	std::vector<unsigned char> payload;
+	std::vector<TrajectoryIndexEntry> index;
+	unsigned long long position;
+
+	TrajectoryHeader header;
+	TrajectoryQuantizer quantizer;
+	int particleCount;
+	bool recording;
+	std::chrono::steady_clock::time_point startTime;
+
+	//Guarded by mutex
+	RecorderStats stats;
+
+	void writerLoop();
+	void writeFrame(Frame& frame);
+};